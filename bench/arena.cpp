@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include "../src/io/rom_cache.hpp"
+#include "../src/sys/arena.hpp"
+
+/*
+ * Machine arena benchmark.
+ *
+ * Creates, briefly runs and discards a million machines, like a fuzzing
+ * campaign would, once with new/delete and once through a MachineArena,
+ * and reports the cost per machine and the heap allocations made. The
+ * global operator new is replaced to count them. Pass a .nes file to
+ * insert a cartridge in every machine instead of the built-in RAM loop.
+ */
+
+constexpr size_t   MACHINES = 1'000'000;
+constexpr size_t   LIVE = 64; // Machines alive at once
+constexpr uint64_t CYCLES = 100; // Run per machine
+
+static uint64_t    allocations = 0;
+
+void              *operator new(size_t size) {
+  allocations++;
+  if (void *p = std::malloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void *operator new(size_t size, std::align_val_t align) {
+  allocations++;
+  size_t alignment = static_cast<size_t>(align);
+  if (void *p = std::aligned_alloc(alignment,
+                                   (size + alignment - 1) / alignment * alignment)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+// clang-format off
+static const std::vector<uint8_t> LOOP = {
+    0xE6, 0x10,       // loop: INC $10
+    0x4C, 0x00, 0x02, //       JMP loop
+};
+// clang-format on
+
+static void prepare(Machine &machine, bool has_rom) {
+  if (!has_rom) {
+    for (size_t i = 0; i < LOOP.size(); i++) {
+      machine.bus.write(0x0200 + i, LOOP[i]);
+    }
+    machine.cpu.set_pc(0x0200);
+  }
+  machine.scheduler.run_cycles(CYCLES);
+  if (machine.bus.get_cycles() < CYCLES) {
+    throw std::runtime_error("Machine did not run");
+  }
+}
+
+int main(int argc, char **argv) {
+  std::shared_ptr<const Reader> rom;
+  if (argc > 1) {
+    rom = RomCache::instance().load(argv[1]);
+  }
+
+  /// Baseline: every machine is its own heap allocation.
+  uint64_t start_allocs = allocations;
+  auto     start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < MACHINES; i += LIVE) {
+    std::unique_ptr<Machine> live[LIVE];
+    for (size_t m = 0; m < LIVE; m++) {
+      live[m] = std::make_unique<Machine>();
+      if (rom != nullptr) {
+        live[m]->bus.insert_cartridge(rom);
+        live[m]->cpu.reset();
+      }
+      prepare(*live[m], rom != nullptr);
+    }
+  }
+  auto     end = std::chrono::steady_clock::now();
+  double   heap_ns = std::chrono::duration<double, std::nano>(end - start).count();
+  uint64_t heap_allocs = allocations - start_allocs;
+
+  MachineArena arena(LIVE, rom);
+  start_allocs = allocations;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < MACHINES; i += LIVE) {
+    Machine *live[LIVE];
+    for (size_t m = 0; m < LIVE; m++) {
+      live[m] = arena.create();
+      prepare(*live[m], rom != nullptr);
+    }
+    for (size_t m = 0; m < LIVE; m++) {
+      arena.destroy(live[m]);
+    }
+  }
+  end = std::chrono::steady_clock::now();
+  double   arena_ns = std::chrono::duration<double, std::nano>(end - start).count();
+  uint64_t arena_allocs = allocations - start_allocs;
+
+  std::printf("machines:     %zu (%zu live at once)\n", MACHINES, LIVE);
+  std::printf("new/delete:   %.1f ns/machine, %llu allocations\n",
+              heap_ns / MACHINES, (unsigned long long)heap_allocs);
+  std::printf("arena:        %.1f ns/machine, %llu allocations\n",
+              arena_ns / MACHINES, (unsigned long long)arena_allocs);
+  return 0;
+}
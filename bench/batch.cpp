@@ -0,0 +1,73 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "../src/io/rom_cache.hpp"
+#include "../src/sys/batch.hpp"
+
+/*
+ * Batch throughput benchmark.
+ *
+ * Runs batches of growing size on one thread for a fixed number of frames
+ * each and reports the aggregate frames per second, i.e. how much the
+ * per-core throughput changes as more machines share the interpreter.
+ * Pass a .nes file to run a cartridge instead of the built-in RAM loop.
+ */
+
+constexpr int    FRAMES = 60;
+constexpr size_t SIZES[] = {1, 4, 16, 64, 256, 1024};
+
+// clang-format off
+static const std::vector<uint8_t> LOOP = {
+    0x78,             //       SEI
+    0xE6, 0x10,       // loop: INC $10
+    0xA5, 0x10,       //       LDA $10
+    0x9D, 0x00, 0x03, //       STA $0300,X
+    0x9D, 0x00, 0x05, //       STA $0500,X
+    0xE8,             //       INX
+    0x4C, 0x01, 0x02, //       JMP loop
+};
+// clang-format on
+
+int main(int argc, char **argv) {
+  std::shared_ptr<const Reader> rom;
+  if (argc > 1) {
+    rom = RomCache::instance().load(argv[1]);
+  }
+
+  std::printf("%8s %14s %14s\n", "machines", "frames/s", "frames/s/mach");
+  for (size_t size : SIZES) {
+    Batch batch(size, rom);
+    if (rom == nullptr) {
+      for (size_t m = 0; m < size; m++) {
+        Machine &machine = batch.get_machine(m);
+        for (size_t i = 0; i < LOOP.size(); i++) {
+          machine.bus.write(0x0200 + i, LOOP[i]);
+        }
+        machine.cpu.set_pc(0x0200);
+      }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++) {
+      batch.run_frame();
+    }
+    auto   end = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+
+    /// Identical machines must stay in lockstep.
+    const BatchRegisters &regs = batch.get_registers();
+    for (size_t m = 1; m < size; m++) {
+      if (regs.pc[m] != regs.pc[0] || regs.cycles[m] != regs.cycles[0]) {
+        throw std::runtime_error("Batched machines diverged");
+      }
+    }
+
+    double total = double(size) * FRAMES / secs;
+    std::printf("%8zu %14.0f %14.1f\n", size, total, total / size);
+  }
+  return 0;
+}
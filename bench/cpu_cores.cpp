@@ -0,0 +1,95 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "../src/dev/nes6502.hpp"
+
+/*
+ * Interpreter core benchmark.
+ *
+ * Runs a long nested loop (16-bit counter updates behind a JSR) through
+ * NES6502::run() and reports MIPS. Build once as-is and once with
+ * -DMP6502_THREADED_CORE to compare the portable and threaded cores;
+ * the checksum line must match between the two builds.
+ */
+
+constexpr uint64_t CYCLES = 1'000'000'000;
+
+struct Block {
+  uint16_t             origin;
+  std::vector<uint8_t> code;
+};
+
+// clang-format off
+static const std::vector<Block> PROGRAM = {
+    {0x0200, {
+        0xA2, 0x00,       // outer: LDX #$00
+        0xA0, 0x00,       // mid:   LDY #$00
+        0x20, 0x20, 0x02, // inner: JSR $0220
+        0xC8,             //        INY
+        0xD0, 0xFA,       //        BNE inner
+        0xE8,             //        INX
+        0xD0, 0xF5,       //        BNE mid
+        0x4C, 0x00, 0x02, //        JMP outer
+    }},
+    {0x0220, {
+        0xA5, 0x10,       // LDA $10
+        0x18,             // CLC
+        0x69, 0x03,       // ADC #$03
+        0x85, 0x10,       // STA $10
+        0xA5, 0x11,       // LDA $11
+        0x69, 0x00,       // ADC #$00
+        0x85, 0x11,       // STA $11
+        0x45, 0x12,       // EOR $12
+        0x85, 0x12,       // STA $12
+        0x60,             // RTS
+    }},
+};
+// clang-format on
+
+static void load(NES6502 &cpu) {
+  for (const Block &block : PROGRAM) {
+    for (size_t i = 0; i < block.code.size(); i++) {
+      cpu.get_bus().write(block.origin + i, block.code[i]);
+    }
+  }
+  cpu.set_pc(0x0200);
+}
+
+int main() {
+  /// Measure the loop's cycles per instruction with step() so run(),
+  /// which only reports cycles, can be converted to instructions.
+  Bus      probe_bus;
+  NES6502  probe(probe_bus);
+  uint64_t probe_cycles = 0;
+  load(probe);
+  for (int i = 0; i < 1'000'000; i++) {
+    probe_cycles += probe.step();
+  }
+  double cpi = probe_cycles / 1e6;
+
+  Bus     bus;
+  NES6502 cpu(bus);
+  load(cpu);
+  auto     start = std::chrono::steady_clock::now();
+  uint64_t cycles = cpu.run(CYCLES);
+  auto     end = std::chrono::steady_clock::now();
+
+  uint32_t checksum = cpu.get_pc();
+  for (uint16_t addr = 0x0000; addr < 0x0200; addr++) {
+    checksum = checksum * 31 + cpu.get_bus().read(addr);
+  }
+
+  double secs = std::chrono::duration<double>(end - start).count();
+#if defined(MP6502_THREADED_CORE) && defined(__GNUC__)
+  std::printf("core:     threaded\n");
+#else
+  std::printf("core:     portable\n");
+#endif
+  std::printf("cycles:   %llu\n", (unsigned long long)cycles);
+  std::printf("seconds:  %.3f\n", secs);
+  std::printf("MIPS:     %.1f\n", cycles / cpi / secs / 1e6);
+  std::printf("checksum: %08x\n", checksum);
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../src/dev/nes6502.hpp"
+
+/*
+ * Dispatch microbenchmark.
+ *
+ * Runs a small ALU/branch loop out of internal RAM, once through
+ * NES6502::step() (the compile-time table of fused handlers) and once
+ * through step_baseline() (the startup-filled table of member pointer
+ * pairs it replaced), and reports instructions per second for each and
+ * the speedup. Both runs must end in the same CPU and RAM state.
+ */
+
+#ifndef MP6502_DISPATCH_BASELINE
+#error "Build with -DMP6502_DISPATCH_BASELINE for the path to compare against"
+#endif
+
+constexpr uint16_t LOOP_ORIGIN = 0x0200;
+constexpr uint64_t INSTRUCTIONS = 200'000'000;
+
+// clang-format off
+static const std::vector<uint8_t> LOOP = {
+    0xA2, 0x00,       // LDX #$00
+    0xB5, 0x10,       // loop: LDA $10,X
+    0x69, 0x01,       // ADC #$01
+    0x95, 0x10,       // STA $10,X
+    0x29, 0x7F,       // AND #$7F
+    0x05, 0x20,       // ORA $20
+    0x49, 0x55,       // EOR #$55
+    0xC9, 0x40,       // CMP #$40
+    0xE8,             // INX
+    0xD0, 0xEF,       // BNE loop
+    0x4C, 0x00, 0x02, // JMP $0200
+};
+// clang-format on
+
+struct Result {
+  uint64_t cycles;
+  double   secs;
+  uint16_t pc;
+  uint8_t  acc, irx, iry, stp, status;
+  uint8_t  ram[0x100]; // Zero page, where the loop keeps its data
+};
+
+/* Run the loop for INSTRUCTIONS instructions through `step`. */
+static Result run_loop(uint8_t (NES6502::*step)(), NES6502::FetchStats *fetch) {
+  Bus     bus;
+  NES6502 cpu(bus);
+  for (size_t i = 0; i < LOOP.size(); i++) {
+    bus.write(LOOP_ORIGIN + i, LOOP[i]);
+  }
+  cpu.set_pc(LOOP_ORIGIN);
+
+  Result result = {};
+  auto   start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < INSTRUCTIONS; i++) {
+    result.cycles += (cpu.*step)();
+  }
+  auto end = std::chrono::steady_clock::now();
+  result.secs = std::chrono::duration<double>(end - start).count();
+  result.pc = cpu.get_pc();
+  result.acc = cpu.get_acc();
+  result.irx = cpu.get_irx();
+  result.iry = cpu.get_iry();
+  result.stp = cpu.get_stp();
+  result.status = cpu.get_status();
+  for (uint16_t addr = 0; addr < 0x100; addr++) {
+    result.ram[addr] = bus.read(addr);
+  }
+  if (fetch != nullptr) {
+    *fetch = cpu.get_fetch_stats();
+  }
+  return result;
+}
+
+int main() {
+  NES6502::FetchStats fetch;
+  Result              fused = run_loop(&NES6502::step, &fetch);
+  Result              baseline = run_loop(&NES6502::step_baseline, nullptr);
+  if (fused.cycles != baseline.cycles || fused.pc != baseline.pc ||
+      fused.acc != baseline.acc || fused.irx != baseline.irx ||
+      fused.iry != baseline.iry || fused.stp != baseline.stp ||
+      fused.status != baseline.status ||
+      std::memcmp(fused.ram, baseline.ram, sizeof(fused.ram)) != 0) {
+    std::fprintf(stderr, "Dispatch paths ended in different states\n");
+    return 1;
+  }
+
+  std::printf("instructions: %llu\n", (unsigned long long)INSTRUCTIONS);
+  std::printf("cycles:       %llu\n", (unsigned long long)fused.cycles);
+  std::printf("seconds:      %.3f (baseline %.3f)\n", fused.secs,
+              baseline.secs);
+  std::printf("MIPS:         %.1f\n", INSTRUCTIONS / fused.secs / 1e6);
+  std::printf("baseline:     %.1f MIPS (member pointer table)\n",
+              INSTRUCTIONS / baseline.secs / 1e6);
+  std::printf("speedup:      %.2fx\n", baseline.secs / fused.secs);
+  std::printf("fetch hits:   %.4f%%\n",
+              100.0 * fetch.hits / (fetch.hits + fetch.misses));
+  return 0;
+}
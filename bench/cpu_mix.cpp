@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../src/dev/nes6502.hpp"
+
+/*
+ * CPU opcode mix benchmark.
+ *
+ * Runs small synthetic programs, each dominated by one opcode class and
+ * addressing mode, from internal RAM through NES6502::run() and prints
+ * ns per instruction for each as JSON on stdout, then the same totalled
+ * per opcode class and per addressing mode. Keys and their order are
+ * fixed so successive runs can be diffed or collected for regression
+ * tracking. Each kernel is timed several times and the fastest run kept.
+ */
+
+constexpr uint64_t CYCLES = 50'000'000; // Per timed run
+constexpr uint64_t WARMUP_CYCLES = 1'000'000;
+constexpr int      RUNS = 3;
+constexpr uint16_t ORIGIN = 0x0200;
+constexpr uint16_t CODE_END = 0x0240; // pc must stay below this
+
+struct Block {
+  uint16_t             origin;
+  std::vector<uint8_t> code;
+};
+
+struct Kernel {
+  const char        *name;
+  const char        *op_class;
+  const char        *mode;
+  std::vector<Block> blocks;
+};
+
+// clang-format off
+static const std::vector<Kernel> KERNELS = {
+    {"alu_imm", "alu", "imm", {{0x0200, {
+        0x18,             // loop: CLC
+        0x69, 0x03,       //       ADC #$03
+        0x38,             //       SEC
+        0xE9, 0x01,       //       SBC #$01
+        0xC9, 0x40,       //       CMP #$40
+        0x69, 0x07,       //       ADC #$07
+        0xC9, 0x80,       //       CMP #$80
+        0xE9, 0x02,       //       SBC #$02
+        0x4C, 0x00, 0x02, //       JMP loop
+    }}}},
+    {"alu_zp", "alu", "zp", {{0x0200, {
+        0xA5, 0x10,       // loop: LDA $10
+        0x65, 0x11,       //       ADC $11
+        0x85, 0x10,       //       STA $10
+        0xE5, 0x12,       //       SBC $12
+        0xC5, 0x13,       //       CMP $13
+        0x45, 0x11,       //       EOR $11
+        0x85, 0x12,       //       STA $12
+        0x4C, 0x00, 0x02, //       JMP loop
+    }}}},
+    {"mem_absx", "memory", "absx", {{0x0200, {
+        0xA2, 0x00,       // sweep: LDX #$00
+        0xBD, 0x00, 0x03, // loop:  LDA $0300,X
+        0x7D, 0x80, 0x03, //        ADC $0380,X (crosses a page for X >= $80)
+        0x9D, 0x00, 0x05, //        STA $0500,X
+        0xE8,             //        INX
+        0xD0, 0xF4,       //        BNE loop
+        0x4C, 0x00, 0x02, //        JMP sweep
+    }}}},
+    {"mem_indy", "memory", "indy", {{0x0200, {
+        0xA9, 0x00,       //        LDA #$00
+        0x85, 0x20,       //        STA $20
+        0x85, 0x22,       //        STA $22
+        0xA9, 0x03,       //        LDA #$03
+        0x85, 0x21,       //        STA $21  ($20) -> $0300
+        0xA9, 0x05,       //        LDA #$05
+        0x85, 0x23,       //        STA $23  ($22) -> $0500
+        0xA0, 0x00,       // sweep: LDY #$00
+        0xB1, 0x20,       // loop:  LDA ($20),Y
+        0x71, 0x20,       //        ADC ($20),Y
+        0x91, 0x22,       //        STA ($22),Y
+        0xC8,             //        INY
+        0xD0, 0xF7,       //        BNE loop
+        0x4C, 0x0E, 0x02, //        JMP sweep
+    }}}},
+    {"branch", "branch", "rel", {{0x0200, {
+        0xA0, 0x00,       // start: LDY #$00
+        0xC8,             // loop:  INY
+        0xC0, 0x80,       //        CPY #$80
+        0xB0, 0x00,       //        BCS +0 (taken for the upper half)
+        0x98,             //        TYA
+        0x29, 0x01,       //        AND #$01
+        0xD0, 0x00,       //        BNE +0 (taken on odd Y)
+        0xF0, 0x00,       //        BEQ +0 (taken on even Y)
+        0xC0, 0x00,       //        CPY #$00
+        0xD0, 0xF0,       //        BNE loop
+        0x4C, 0x00, 0x02, //        JMP start
+    }}}},
+    {"stack", "stack", "impl", {
+        {0x0200, {
+            0x78,             //       SEI (else PLP ends every run() batch)
+            0x20, 0x20, 0x02, // loop: JSR sub
+            0x48,             //       PHA
+            0x08,             //       PHP
+            0x28,             //       PLP
+            0x68,             //       PLA
+            0x20, 0x20, 0x02, //       JSR sub
+            0x4C, 0x01, 0x02, //       JMP loop
+        }},
+        {0x0220, {
+            0x48,             // sub:  PHA
+            0x68,             //       PLA
+            0x60,             //       RTS
+        }},
+    }},
+};
+// clang-format on
+
+struct Result {
+  uint64_t instructions;
+  uint64_t cycles;
+  double   ns;
+};
+
+static Result run_kernel(const Kernel &kernel) {
+  Bus     bus;
+  NES6502 cpu(bus);
+  for (const Block &block : kernel.blocks) {
+    for (size_t i = 0; i < block.code.size(); i++) {
+      bus.write(block.origin + i, block.code[i]);
+    }
+  }
+  cpu.set_pc(ORIGIN);
+  cpu.run(WARMUP_CYCLES);
+
+  Result best = {0, 0, 0};
+  for (int r = 0; r < RUNS; r++) {
+    uint64_t instructions = cpu.get_instructions();
+    auto     start = std::chrono::steady_clock::now();
+    uint64_t cycles = cpu.run(CYCLES);
+    auto     end = std::chrono::steady_clock::now();
+    double   ns = std::chrono::duration<double, std::nano>(end - start).count();
+    instructions = cpu.get_instructions() - instructions;
+    if (cycles < CYCLES) {
+      throw std::runtime_error(std::string("Kernel ") + kernel.name +
+                               " stopped early");
+    }
+    if (best.instructions == 0 ||
+        ns / instructions < best.ns / best.instructions) {
+      best = {instructions, cycles, ns};
+    }
+  }
+  if (cpu.get_pc() < ORIGIN || cpu.get_pc() >= CODE_END) {
+    throw std::runtime_error(std::string("Kernel ") + kernel.name +
+                             " ran away");
+  }
+  return best;
+}
+
+/* Print `results` totalled per distinct value of `key` (a Kernel field),
+ * in order of first appearance, as the JSON array `name`.
+ */
+static void print_totals(const char *name, const char *Kernel::*key,
+                         const std::vector<Result> &results, bool last) {
+  std::vector<std::string> groups;
+  for (const Kernel &kernel : KERNELS) {
+    if (std::find(groups.begin(), groups.end(), kernel.*key) == groups.end()) {
+      groups.push_back(kernel.*key);
+    }
+  }
+  std::printf("  \"%s\": [\n", name);
+  for (size_t g = 0; g < groups.size(); g++) {
+    Result total = {0, 0, 0};
+    for (size_t k = 0; k < KERNELS.size(); k++) {
+      if (groups[g] == KERNELS[k].*key) {
+        total.instructions += results[k].instructions;
+        total.cycles += results[k].cycles;
+        total.ns += results[k].ns;
+      }
+    }
+    std::printf("    {\"name\": \"%s\", \"instructions\": %llu, "
+                "\"cycles\": %llu, \"ns_per_instruction\": %.3f, "
+                "\"mips\": %.1f}%s\n",
+                groups[g].c_str(), (unsigned long long)total.instructions,
+                (unsigned long long)total.cycles,
+                total.ns / total.instructions,
+                total.instructions * 1e3 / total.ns,
+                g + 1 < groups.size() ? "," : "");
+  }
+  std::printf("  ]%s\n", last ? "" : ",");
+}
+
+int main() {
+#if defined(MP6502_THREADED_CORE) && defined(__GNUC__)
+  const char *core = "threaded";
+#else
+  const char *core = "portable";
+#endif
+#ifdef MP6502_LAZY_FLAGS
+  const char *flags = "lazy";
+#else
+  const char *flags = "packed";
+#endif
+
+  std::printf("{\n");
+  std::printf("  \"benchmark\": \"cpu_mix\",\n");
+  std::printf("  \"core\": \"%s\",\n", core);
+  std::printf("  \"flags\": \"%s\",\n", flags);
+  std::printf("  \"cycles_per_run\": %llu,\n", (unsigned long long)CYCLES);
+  std::printf("  \"kernels\": [\n");
+  std::vector<Result> results;
+  for (size_t k = 0; k < KERNELS.size(); k++) {
+    const Kernel &kernel = KERNELS[k];
+    Result        result = run_kernel(kernel);
+    results.push_back(result);
+    std::printf("    {\"name\": \"%s\", \"class\": \"%s\", \"mode\": \"%s\", "
+                "\"instructions\": %llu, \"cycles\": %llu, "
+                "\"cycles_per_instruction\": %.3f, "
+                "\"ns_per_instruction\": %.3f, \"mips\": %.1f}%s\n",
+                kernel.name, kernel.op_class, kernel.mode,
+                (unsigned long long)result.instructions,
+                (unsigned long long)result.cycles,
+                double(result.cycles) / result.instructions,
+                result.ns / result.instructions,
+                result.instructions * 1e3 / result.ns,
+                k + 1 < KERNELS.size() ? "," : "");
+  }
+  std::printf("  ],\n");
+  print_totals("classes", &Kernel::op_class, results, false);
+  print_totals("modes", &Kernel::mode, results, true);
+  std::printf("}\n");
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../src/io/rom_cache.hpp"
+#include "../src/sys/pool.hpp"
+
+/*
+ * Instance pool scaling benchmark.
+ *
+ * Runs the same number of instances on 1, 2, 4, ... workers, up to the
+ * number of hardware threads (at most 64), and reports aggregate frames
+ * per second, the speedup over one worker and the mean and lowest worker
+ * utilization. Pass a .nes file to run a cartridge instead of the
+ * built-in RAM loop.
+ *
+ * First it checks that a frame that throws (an unimplemented opcode) ends
+ * run_frames() with that exception on any number of workers, and that the
+ * pool runs normally afterwards.
+ */
+
+constexpr size_t INSTANCES = 256;
+constexpr int    FRAMES = 30;
+constexpr size_t MAX_WORKERS = 64;
+
+// clang-format off
+static const std::vector<uint8_t> LOOP = {
+    0x78,             //       SEI
+    0xE6, 0x10,       // loop: INC $10
+    0xA5, 0x10,       //       LDA $10
+    0x9D, 0x00, 0x03, //       STA $0300,X
+    0x9D, 0x00, 0x05, //       STA $0500,X
+    0xE8,             //       INX
+    0x4C, 0x01, 0x02, //       JMP loop
+};
+// clang-format on
+
+static void load_loop(Machine &machine) {
+  for (size_t i = 0; i < LOOP.size(); i++) {
+    machine.bus.write(0x0200 + i, LOOP[i]);
+  }
+  machine.cpu.set_pc(0x0200);
+}
+
+static void check_abort(size_t workers) {
+  InstancePool pool(4, nullptr, workers);
+  for (size_t m = 0; m < pool.size(); m++) {
+    load_loop(pool.get_machine(m));
+  }
+  Machine &broken = pool.get_machine(1);
+  broken.bus.write(0x0000, 0x02); // Unimplemented: throws
+  broken.cpu.set_pc(0x0000);
+  bool threw = false;
+  try {
+    pool.run_frames(3);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  if (!threw) {
+    throw std::runtime_error("A throwing frame did not stop run_frames()");
+  }
+
+  load_loop(broken);
+  uint64_t before = broken.bus.get_cycles();
+  pool.run_frames(3);
+  /// Each quantum runs to the next frame boundary, so three of them
+  /// cross at least two whole frames.
+  if (broken.bus.get_cycles() - before <= CPU_CYCLES_PER_TWO_FRAMES) {
+    throw std::runtime_error("Pool did not recover after a throwing frame");
+  }
+}
+
+int main(int argc, char **argv) {
+  std::shared_ptr<const Reader> rom;
+  if (argc > 1) {
+    rom = RomCache::instance().load(argv[1]);
+  }
+  size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  check_abort(1);
+  check_abort(2);
+
+  std::printf("%7s %12s %8s %9s %9s %7s\n", "workers", "frames/s", "speedup",
+              "mean util", "min util", "steals");
+  double base = 0;
+  for (size_t workers = 1; workers <= std::min(hardware, MAX_WORKERS);
+       workers *= 2) {
+    InstancePool pool(INSTANCES, rom, workers);
+    if (rom == nullptr) {
+      for (size_t m = 0; m < pool.size(); m++) {
+        load_loop(pool.get_machine(m));
+      }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pool.run_frames(FRAMES);
+    auto   end = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+
+    double   total = double(INSTANCES) * FRAMES / secs;
+    double   util_sum = 0;
+    double   util_min = 1;
+    uint64_t steals = 0;
+    for (size_t w = 0; w < pool.worker_count(); w++) {
+      const WorkerStats &stats = pool.get_worker_stats(w);
+      util_sum += stats.utilization;
+      util_min = std::min(util_min, stats.utilization);
+      steals += stats.steals;
+    }
+    if (workers == 1) {
+      base = total;
+    }
+    std::printf("%7zu %12.0f %7.2fx %8.1f%% %8.1f%% %7llu\n", workers, total,
+                total / base, 100 * util_sum / workers, 100 * util_min,
+                (unsigned long long)steals);
+  }
+  return 0;
+}
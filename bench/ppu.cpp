@@ -0,0 +1,240 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+#include "../src/sys/machine.hpp"
+
+/*
+ * PPU benchmark.
+ *
+ * Runs a generated NROM cartridge that scrolls a full screen of tiles and
+ * moves 64 sprites every frame, once per render mode, and reports frames
+ * per second for each. The two machines are stepped frame by frame and
+ * must produce identical pictures, so the scanline renderer is checked
+ * against the dot pipeline as a side effect. The cartridge is run once
+ * with CHR ROM and once with the same tiles uploaded to CHR RAM through
+ * $2007, which checks that the pre-decoded tile rows follow RAM writes.
+ *
+ * The main loop counts how many $2002 polls each sprite 0 hit takes, so
+ * all machines must also stay in lockstep: the scanline renderer's
+ * predicted hit has to land on the same CPU cycle as the dot pipeline's.
+ * A third machine composes only every SKIP_INTERVALth frame and must show
+ * the same picture on the frames it draws. Finally the RGBA view of the
+ * last picture is checked against the palette and its conversion timed.
+ */
+
+constexpr int      FRAMES = 600;
+constexpr uint32_t SKIP_INTERVAL = 4;
+constexpr int      RGBA_RUNS = 2000;
+
+// clang-format off
+static const std::vector<uint8_t> RESET = {
+    0x78,             // $8000:  SEI
+    0x2C, 0x02, 0x20, // wait:   BIT $2002
+    0x10, 0xFB,       //         BPL wait (turn rendering on in vblank)
+    0xA9, 0x80,       //         LDA #$80
+    0x8D, 0x00, 0x20, //         STA $2000 (NMI on)
+    0xA9, 0x1E,       //         LDA #$1E
+    0x8D, 0x01, 0x20, //         STA $2001 (background and sprites on)
+    0x2C, 0x02, 0x20, // clear:  BIT $2002
+    0x70, 0xFB,       //         BVS clear (until pre-render clears it)
+    0xA2, 0x00,       //         LDX #$00
+    0xE8,             // hit:    INX
+    0x2C, 0x02, 0x20, //         BIT $2002
+    0x50, 0xFA,       //         BVC hit (until sprite 0 hits)
+    0x86, 0x01,       //         STX $01 (polls it took)
+    0xE6, 0x02,       //         INC $02 (hits)
+    0x4C, 0x10, 0x80, //         JMP clear
+};
+static const std::vector<uint8_t> NMI = {
+    0xE6, 0x00,       // $8030:  INC $00
+    0xA5, 0x00,       //         LDA $00
+    0x8D, 0x05, 0x20, //         STA $2005 (scroll X)
+    0xA9, 0x00,       //         LDA #$00
+    0x8D, 0x05, 0x20, //         STA $2005 (scroll Y)
+    0xA9, 0x02,       //         LDA #$02
+    0x8D, 0x14, 0x40, //         STA $4014 (OAM DMA from $0200)
+    0xEE, 0x03, 0x02, //         INC $0203 (sprite 0 X)
+    0xEE, 0x07, 0x02, //         INC $0207
+    0x40,             //         RTI
+};
+// clang-format on
+
+/* Pattern data for both pattern tables. */
+static uint8_t chr_byte(int addr) {
+  int tile = addr / 16;
+  int row = addr % 8;
+  return addr & 0x08 ? uint8_t(tile ^ (row * 0x11))
+                     : uint8_t(tile * 0x1D + row * 0x53);
+}
+
+/* Write a one-off .nes file to a temporary path and return the path. */
+static std::string make_rom(bool chr_ram) {
+  std::vector<uint8_t> image(16 + 0x4000 + (chr_ram ? 0 : 0x2000), 0);
+  const uint8_t header[] = {'N', 'E', 'S', 0x1A, 1, uint8_t(chr_ram ? 0 : 1),
+                            0x01};
+  std::memcpy(image.data(), header, sizeof(header));
+  uint8_t *prg = image.data() + 16;
+  std::memcpy(prg, RESET.data(), RESET.size());
+  std::memcpy(prg + 0x30, NMI.data(), NMI.size());
+  const uint8_t vectors[] = {0x30, 0x80, 0x00, 0x80, 0x00, 0x80};
+  std::memcpy(prg + 0x3FFA, vectors, sizeof(vectors));
+  if (!chr_ram) {
+    for (int addr = 0; addr < 0x2000; addr++) {
+      prg[0x4000 + addr] = chr_byte(addr);
+    }
+  }
+
+  char path[] = "/tmp/mp6502_ppuXXXXXX";
+  int  fd = mkstemp(path);
+  if (fd < 0 || write(fd, image.data(), image.size()) != ssize_t(image.size())) {
+    throw std::runtime_error("Cannot write the benchmark ROM");
+  }
+  close(fd);
+  return path;
+}
+
+static void prepare(Machine &machine, std::shared_ptr<const Reader> rom) {
+  bool chr_ram = rom->get_chr().size == 0;
+  machine.bus.insert_cartridge(std::move(rom));
+  Bus &bus = machine.bus;
+  /// Pattern tables (if RAM), palette, both nametables and their
+  /// attributes, then OAM by DMA, all before the PPU has drawn a dot.
+  if (chr_ram) {
+    bus.write(0x2006, 0x00);
+    bus.write(0x2006, 0x00);
+    for (int addr = 0; addr < 0x2000; addr++) {
+      bus.write(0x2007, chr_byte(addr));
+    }
+  }
+  bus.write(0x2006, 0x3F);
+  bus.write(0x2006, 0x00);
+  for (int i = 0; i < PALETTE_SIZE; i++) {
+    bus.write(0x2007, uint8_t(i * 7 + 1));
+  }
+  bus.write(0x2006, 0x20);
+  bus.write(0x2006, 0x00);
+  for (int i = 0; i < 0x800; i++) {
+    bus.write(0x2007, uint8_t(i * 5 + i / 32));
+  }
+  for (int i = 0; i < 64; i++) {
+    bus.write(0x0200 + i * 4, uint8_t(i * 3 + 16)); // Y
+    bus.write(0x0201 + i * 4, uint8_t(i));
+    bus.write(0x0202 + i * 4, uint8_t(i & 0xE3));
+    bus.write(0x0203 + i * 4, uint8_t(i * 29));
+  }
+  bus.write(0x4014, 0x02);
+  machine.cpu.reset();
+}
+
+/* Compare two PPUs' finished pictures. */
+static bool same_picture(const PPU &a, const PPU &b) {
+  return a.get_frame_number() == b.get_frame_number() &&
+         std::memcmp(a.get_frame(), b.get_frame(), SCREEN_PIXELS) == 0;
+}
+
+/* Check the RGBA view of `ppu`'s picture against the palette table, then
+ * time converting it, returning ns per picture.
+ */
+static double time_rgba(PPU &ppu) {
+  const uint32_t *rgba = ppu.get_frame_rgba();
+  for (size_t i = 0; i < SCREEN_PIXELS; i++) {
+    if (rgba[i] != nes_rgba(ppu.get_frame()[i])) {
+      throw std::runtime_error("RGBA view does not match the palette");
+    }
+  }
+  std::vector<uint32_t> out(SCREEN_PIXELS);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < RGBA_RUNS; i++) {
+    indices_to_rgba(ppu.get_frame(), out.data(), SCREEN_PIXELS);
+  }
+  auto end = std::chrono::steady_clock::now();
+  if (std::memcmp(out.data(), rgba, SCREEN_PIXELS * 4) != 0) {
+    throw std::runtime_error("RGBA conversion is not repeatable");
+  }
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         RGBA_RUNS;
+}
+
+/* Whether two machines' CPUs are at the same point of the same program. */
+static bool same_cpu(Machine &a, Machine &b) {
+  return a.bus.get_cycles() == b.bus.get_cycles() &&
+         a.cpu.get_pc() == b.cpu.get_pc() &&
+         a.bus.read(0x0001) == b.bus.read(0x0001) &&
+         a.bus.read(0x0002) == b.bus.read(0x0002);
+}
+
+/* Run one frame on `machine`, adding the wall time to `ns`. */
+static void timed_frame(Machine &machine, double &ns) {
+  auto start = std::chrono::steady_clock::now();
+  machine.scheduler.run_frame();
+  auto end = std::chrono::steady_clock::now();
+  ns += std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+int main() {
+  std::printf("%-6s %14s %14s %14s %9s %9s %9s\n", "chr", "scanline f/s",
+              "dot f/s", "skip f/s", "dot rel", "skip rel", "rgba ns");
+  for (bool chr_ram : {false, true}) {
+    std::string                   path = make_rom(chr_ram);
+    std::shared_ptr<const Reader> rom = std::make_shared<Reader>(path);
+    unlink(path.c_str());
+
+    auto scanline = std::make_unique<Machine>();
+    auto dot = std::make_unique<Machine>();
+    auto skip = std::make_unique<Machine>();
+    dot->bus.get_ppu().set_mode(RenderMode::Dot);
+    skip->bus.get_ppu().set_render_interval(SKIP_INTERVAL);
+    prepare(*scanline, rom);
+    prepare(*dot, rom);
+    prepare(*skip, rom);
+
+    double scanline_ns = 0;
+    double dot_ns = 0;
+    double skip_ns = 0;
+    for (int f = 0; f < FRAMES; f++) {
+      timed_frame(*scanline, scanline_ns);
+      timed_frame(*dot, dot_ns);
+      timed_frame(*skip, skip_ns);
+
+      if (!same_picture(scanline->bus.get_ppu(), dot->bus.get_ppu())) {
+        std::fprintf(stderr, "Render modes diverged in frame %d\n", f);
+        return 1;
+      }
+      if (!same_cpu(*scanline, *dot)) {
+        std::fprintf(stderr, "Sprite 0 hit timing differs in frame %d\n", f);
+        return 1;
+      }
+      if (!same_cpu(*scanline, *skip)) {
+        std::fprintf(stderr, "Frame skipping changed the CPU in frame %d\n",
+                     f);
+        return 1;
+      }
+      if (skip->bus.get_ppu().get_frames() % SKIP_INTERVAL == 0 &&
+          !same_picture(scanline->bus.get_ppu(), skip->bus.get_ppu())) {
+        std::fprintf(stderr, "Frame skipping diverged in frame %d\n", f);
+        return 1;
+      }
+    }
+    if (scanline->bus.get_ppu().get_frames() < FRAMES - 1) {
+      throw std::runtime_error("PPU did not reach vblank every frame");
+    }
+    if (scanline->bus.read(0x0002) == 0) {
+      throw std::runtime_error("Sprite 0 never hit");
+    }
+
+    double rgba_ns = time_rgba(scanline->bus.get_ppu());
+
+    std::printf("%-6s %14.1f %14.1f %14.1f %8.2fx %8.2fx %9.0f\n",
+                chr_ram ? "ram" : "rom", FRAMES * 1e9 / scanline_ns,
+                FRAMES * 1e9 / dot_ns, FRAMES * 1e9 / skip_ns,
+                scanline_ns / dot_ns, scanline_ns / skip_ns, rgba_ns);
+  }
+  return 0;
+}
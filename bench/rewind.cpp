@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "../src/dev/nes6502.hpp"
+#include "../src/io/rom_cache.hpp"
+#include "../src/sys/rewind.hpp"
+#include "../src/sys/scheduler.hpp"
+
+/*
+ * Rewind buffer benchmark.
+ *
+ * Runs frames through the Scheduler, capturing one snapshot per frame,
+ * then repeatedly rewinds and re-simulates like a rollback netcode client
+ * would. Reports the buffer's footprint, the capture cost per frame and
+ * the cost of a rewind. Pass a .nes file to run a cartridge instead of
+ * the built-in RAM loop.
+ */
+
+constexpr size_t CAPACITY = 600; // 10 seconds at 60 frames per second
+constexpr int    FRAMES = 3000;
+constexpr int    ROLLBACKS = 1000;
+constexpr size_t ROLLBACK_FRAMES = 8;
+
+// clang-format off
+static const std::vector<uint8_t> LOOP = {
+    0x78,             //       SEI
+    0xE6, 0x10,       // loop: INC $10
+    0xA5, 0x10,       //       LDA $10
+    0x9D, 0x00, 0x03, //       STA $0300,X
+    0x9D, 0x00, 0x05, //       STA $0500,X
+    0xE8,             //       INX
+    0x4C, 0x01, 0x02, //       JMP loop
+};
+// clang-format on
+
+int main(int argc, char **argv) {
+  Bus     bus;
+  NES6502 cpu(bus);
+  if (argc > 1) {
+    bus.insert_cartridge(RomCache::instance().load(argv[1]));
+    cpu.reset();
+  } else {
+    for (size_t i = 0; i < LOOP.size(); i++) {
+      bus.write(0x0200 + i, LOOP[i]);
+    }
+    cpu.set_pc(0x0200);
+  }
+  Scheduler    scheduler(cpu);
+  RewindBuffer rewind(cpu, CAPACITY);
+
+  for (int i = 0; i < FRAMES; i++) {
+    scheduler.run_frame();
+    rewind.capture();
+  }
+
+  /// Re-simulating the rolled back frames must land on the same state.
+  uint16_t expected_pc = cpu.get_pc();
+  uint64_t expected_cycles = bus.get_cycles();
+  double   rewind_ns = 0;
+  for (int i = 0; i < ROLLBACKS; i++) {
+    auto start = std::chrono::steady_clock::now();
+    rewind.rewind(ROLLBACK_FRAMES);
+    auto end = std::chrono::steady_clock::now();
+    rewind_ns += std::chrono::duration<double, std::nano>(end - start).count();
+    for (size_t f = 0; f < ROLLBACK_FRAMES; f++) {
+      scheduler.run_frame();
+      rewind.capture();
+    }
+    if (cpu.get_pc() != expected_pc || bus.get_cycles() != expected_cycles) {
+      throw std::runtime_error("Re-simulated frames diverged");
+    }
+  }
+
+  RewindStats stats = rewind.get_stats();
+  std::printf("capacity:     %zu frames\n", CAPACITY);
+  std::printf("footprint:    %zu bytes\n", stats.footprint);
+  std::printf("held:         %zu bytes in %zu frames\n", stats.held_bytes,
+              stats.depth);
+  std::printf("keyframes:    %llu of %llu captures\n",
+              (unsigned long long)stats.keyframes,
+              (unsigned long long)stats.captures);
+  std::printf("capture:      %.1f ns/frame\n", stats.capture_ns);
+  std::printf("rewind:       %.1f ns (%zu frames back)\n",
+              rewind_ns / ROLLBACKS, ROLLBACK_FRAMES);
+  return 0;
+}
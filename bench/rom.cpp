@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "../src/io/rom_cache.hpp"
+
+/*
+ * ROM loading benchmark.
+ *
+ * Maps and parses the same .nes file repeatedly, once with a new Reader
+ * each time and once through the RomCache, and reports the mean latency
+ * of each. Pass a .nes file to load it; otherwise a minimal NROM image is
+ * generated.
+ *
+ * First it checks that crafted headers are rejected: NES 2.0 sizes too
+ * large for the exponent-multiplier form, and sizes whose sum wraps
+ * around.
+ */
+
+constexpr int ITERATIONS = 100'000;
+
+/* iNES image with the given header bytes 4-9 and `body` bytes after it. */
+static std::vector<uint8_t> make_image(std::vector<uint8_t> fields,
+                                       size_t               body) {
+  std::vector<uint8_t> image = {'N', 'E', 'S', 0x1A};
+  image.insert(image.end(), fields.begin(), fields.end());
+  image.resize(16 + body, 0);
+  return image;
+}
+
+static std::string write_image(const std::vector<uint8_t> &image) {
+  char path[] = "/tmp/bench_rom_XXXXXX";
+  int  fd = mkstemp(path);
+  if (fd < 0 || write(fd, image.data(), image.size()) != (ssize_t)image.size()) {
+    throw std::runtime_error("cannot write test image");
+  }
+  close(fd);
+  return path;
+}
+
+static void check_rejected(const char *what, const std::vector<uint8_t> &image) {
+  std::string path = write_image(image);
+  bool        threw = false;
+  try {
+    Reader reader(path);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  unlink(path.c_str());
+  if (!threw) {
+    throw std::runtime_error(std::string("Crafted header accepted: ") + what);
+  }
+}
+
+static void check_headers() {
+  /// Byte 7 = $08 marks NES 2.0; byte 9 nibbles $F select exponent form.
+  check_rejected("PRG 2^63 * 7", make_image({0xFF, 0x00, 0x00, 0x08, 0, 0x0F},
+                                            PRG_BANK_SIZE));
+  check_rejected("PRG + CHR wraps", make_image({0xFC, 0xFC, 0x00, 0x08, 0, 0xFF},
+                                               PRG_BANK_SIZE));
+  check_rejected("PRG 2^60 * 7", make_image({0xF3, 0x00, 0x00, 0x08, 0, 0x0F},
+                                            PRG_BANK_SIZE));
+  check_rejected("trainer past the end", make_image({0x01, 0x00, 0x04, 0x00}, 0));
+  check_rejected("truncated PRG", make_image({0x02, 0x00, 0x00, 0x00},
+                                             PRG_BANK_SIZE));
+}
+
+int main(int argc, char **argv) {
+  check_headers();
+
+  std::string path;
+  bool        generated = argc < 2;
+  if (generated) {
+    path = write_image(make_image({0x01, 0x01, 0x00, 0x00},
+                                  PRG_BANK_SIZE + CHR_BANK_SIZE));
+  } else {
+    path = argv[1];
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    Reader reader(path);
+  }
+  auto mid = std::chrono::steady_clock::now();
+  /// Hold one image so every cached load is a hit.
+  std::shared_ptr<const Reader> held = RomCache::instance().load(path);
+  for (int i = 0; i < ITERATIONS; i++) {
+    RomCache::instance().load(path);
+  }
+  auto end = std::chrono::steady_clock::now();
+  if (generated) {
+    unlink(path.c_str());
+  }
+
+  double reader_ns = std::chrono::duration<double, std::nano>(mid - start).count();
+  double cache_ns = std::chrono::duration<double, std::nano>(end - mid).count();
+  std::printf("image size: %zu bytes\n", held->get_image().size);
+  std::printf("Reader:     %.1f ns/load\n", reader_ns / ITERATIONS);
+  std::printf("RomCache:   %.1f ns/load (hit)\n", cache_ns / ITERATIONS);
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "../src/dev/nes6502.hpp"
+#include "../src/io/rom_cache.hpp"
+#include "../src/io/savestate.hpp"
+
+/*
+ * Save state latency benchmark.
+ *
+ * Saves and restores the machine repeatedly into one preallocated buffer
+ * and reports the mean latency of each. Pass a .nes file to include a
+ * cartridge (PRG RAM, CHR RAM and mapper registers) in the state;
+ * otherwise the CPU runs a counter loop out of internal RAM. Also checks
+ * that a restored machine matches the saved one and runs identically to
+ * the original, down to the picture, and measures delta states taken one
+ * frame after the base.
+ */
+
+constexpr int      ITERATIONS = 1'000'000;
+constexpr uint64_t FRAME_CYCLES = 29781;
+
+// clang-format off
+static const std::vector<uint8_t> LOOP = {
+    0xE6, 0x10,       // loop: INC $10
+    0xA5, 0x10,       //       LDA $10
+    0x9D, 0x00, 0x03, //       STA $0300,X
+    0xE8,             //       INX
+    0x4C, 0x00, 0x02, //       JMP loop
+};
+// clang-format on
+
+/* What a restored machine must reproduce: the CPU registers, the clock,
+ * and which picture is in front and of which frame. The PPU is brought up
+ * to the CPU first, as a register access would.
+ */
+static std::vector<uint64_t> observe(NES6502 &cpu) {
+  PPU &ppu = cpu.get_bus().get_ppu();
+  ppu.catch_up(cpu.get_bus().get_cycles());
+  return {cpu.get_pc(),
+          cpu.get_acc(),
+          cpu.get_irx(),
+          cpu.get_iry(),
+          cpu.get_stp(),
+          cpu.get_status(),
+          cpu.get_bus().get_cycles(),
+          ppu.get_frame_number(),
+          reinterpret_cast<uintptr_t>(ppu.get_frame())};
+}
+
+/* The front picture. Not part of the state, so only comparable once a
+ * frame composed after the load is in front.
+ */
+static std::vector<uint8_t> picture(NES6502 &cpu) {
+  PPU &ppu = cpu.get_bus().get_ppu();
+  ppu.catch_up(cpu.get_bus().get_cycles());
+  const uint8_t *pixels = ppu.get_frame();
+  return {pixels, pixels + SCREEN_PIXELS};
+}
+
+int main(int argc, char **argv) {
+  Bus     bus;
+  NES6502 cpu(bus);
+  if (argc > 1) {
+    bus.insert_cartridge(RomCache::instance().load(argv[1]));
+    cpu.reset();
+  } else {
+    for (size_t i = 0; i < LOOP.size(); i++) {
+      bus.write(0x0200 + i, LOOP[i]);
+    }
+    cpu.set_pc(0x0200);
+  }
+  cpu.run(100'000);
+
+  /// Observed first so the state holds the PPU caught up to the CPU: a
+  /// vblank crossed while catching up after the load would hide a lost
+  /// front picture.
+  std::vector<uint64_t> saved = observe(cpu);
+  std::vector<uint8_t>  state(state_size(cpu));
+  size_t                size = save_state(cpu, state.data(), state.size());
+
+  /// Run ahead from the state, rewind, run again: both runs must agree.
+  cpu.run(100'000);
+  std::vector<uint64_t> expected = observe(cpu);
+  std::vector<uint8_t>  expected_picture = picture(cpu);
+  load_state(cpu, state.data(), state.size());
+  if (observe(cpu) != saved) {
+    throw std::runtime_error("Restored machine differs from the saved one");
+  }
+  cpu.run(100'000);
+  if (observe(cpu) != expected || picture(cpu) != expected_picture) {
+    throw std::runtime_error("Restored machine diverged");
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    save_state(cpu, state.data(), state.size());
+  }
+  auto mid = std::chrono::steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    load_state(cpu, state.data(), state.size());
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  /// The loop leaves the machine on the base state; run one frame past it.
+  cpu.run(FRAME_CYCLES);
+  std::vector<uint8_t> delta(delta_size(cpu));
+  size_t               dsize = save_delta(cpu, delta.data(), delta.size());
+  auto                 dstart = std::chrono::steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    save_delta(cpu, delta.data(), delta.size());
+  }
+  auto dmid = std::chrono::steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++) {
+    load_delta(cpu, state.data(), state.size(), delta.data(), delta.size());
+  }
+  auto dend = std::chrono::steady_clock::now();
+
+  double save_ns = std::chrono::duration<double, std::nano>(mid - start).count();
+  double load_ns = std::chrono::duration<double, std::nano>(end - mid).count();
+  double dsave_ns =
+      std::chrono::duration<double, std::nano>(dmid - dstart).count();
+  double dload_ns =
+      std::chrono::duration<double, std::nano>(dend - dmid).count();
+  std::printf("state size: %zu bytes\n", size);
+  std::printf("save:       %.1f ns\n", save_ns / ITERATIONS);
+  std::printf("load:       %.1f ns\n", load_ns / ITERATIONS);
+  std::printf("delta size: %zu bytes\n", dsize);
+  std::printf("delta save: %.1f ns\n", dsave_ns / ITERATIONS);
+  std::printf("delta load: %.1f ns (base load included)\n",
+              dload_ns / ITERATIONS);
+  return 0;
+}
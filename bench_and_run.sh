@@ -0,0 +1,45 @@
+#!/bin/bash
+
+SOURCE_FILES=(
+    "src/dev/apu.cpp"
+    "src/dev/nes6502.cpp"
+    "src/dev/bus.cpp"
+    "src/dev/mapper.cpp"
+    "src/dev/ppu.cpp"
+    "src/io/log.cpp"
+    "src/io/rom.cpp"
+    "src/io/rom_cache.cpp"
+    "src/io/savestate.cpp"
+    "src/sys/arena.cpp"
+    "src/sys/batch.cpp"
+    "src/sys/pool.cpp"
+    "src/sys/rewind.cpp"
+    "src/sys/scheduler.cpp"
+)
+
+if [ ! -d bin ]; then
+    mkdir bin
+fi
+
+# run_bench <name> [extra compiler flags...]
+run_bench() {
+    local name=$1
+    shift
+    rm -f bin/bench_$name
+    g++ -O2 -pthread "$@" bench/$name.cpp ${SOURCE_FILES[@]} -o bin/bench_$name || exit 1
+    ./bin/bench_$name
+}
+
+run_bench cpu_dispatch -DMP6502_DISPATCH_BASELINE
+run_bench cpu_dispatch -DMP6502_DISPATCH_BASELINE -DMP6502_LAZY_FLAGS
+run_bench cpu_cores
+run_bench cpu_cores -DMP6502_THREADED_CORE
+run_bench cpu_mix
+run_bench cpu_mix -DMP6502_THREADED_CORE
+run_bench savestate
+run_bench rewind
+run_bench batch
+run_bench pool
+run_bench arena
+run_bench ppu
+run_bench rom
@@ -6,7 +6,17 @@ SOURCE_FILES=(
     "src/dev/apu.cpp"
     "src/dev/nes6502.cpp"
     "src/dev/bus.cpp"
+    "src/dev/mapper.cpp"
+    "src/dev/ppu.cpp"
+    "src/io/log.cpp"
     "src/io/rom.cpp"
+    "src/io/rom_cache.cpp"
+    "src/io/savestate.cpp"
+    "src/sys/arena.cpp"
+    "src/sys/batch.cpp"
+    "src/sys/pool.cpp"
+    "src/sys/rewind.cpp"
+    "src/sys/scheduler.cpp"
 )
 
 if [ ! -d bin ]; then
@@ -15,5 +25,5 @@ elif [ -f bin/main ]; then
     rm bin/main
 fi
 
-g++ src/main.cpp ${SOURCE_FILES[@]} -o bin/main
-./bin/main
+g++ -O2 -pthread src/main.cpp ${SOURCE_FILES[@]} -o bin/main
+./bin/main "$@"
@@ -1,5 +1,67 @@
 #include "./apu.hpp"
+#include "./clock.hpp"
+#include "../io/log.hpp"
+#include "../io/savestate.hpp"
 
-#include <iostream>
+APU::APU() {
+  MP6502_LOG(LogLevel::Debug, "APU initialized");
+  _cycles = 0;
+  _next_frame_irq = APU_FRAME_IRQ_DELAY;
+  _five_step = false;
+  _irq_inhibit = false;
+  _frame_irq = false;
+}
 
-APU::APU() { std::cout << "APU initialized" << std::endl; }
\ No newline at end of file
+uint8_t APU::read_status() {
+  uint8_t status = _frame_irq ? 0x40 : 0x00;
+  _frame_irq = false;
+  return status;
+}
+
+void APU::write_frame_counter(uint8_t data, uint64_t now) {
+  _five_step = data & 0x80;
+  _irq_inhibit = data & 0x40;
+  if (_irq_inhibit) {
+    _frame_irq = false;
+  }
+  _next_frame_irq = now + APU_FRAME_IRQ_DELAY;
+}
+
+void APU::catch_up(uint64_t now) {
+  if (now <= _cycles) {
+    return;
+  }
+  if (!_five_step && now >= _next_frame_irq) {
+    if (!_irq_inhibit) {
+      _frame_irq = true;
+    }
+    uint64_t periods = (now - _next_frame_irq) / APU_FRAME_PERIOD + 1;
+    _next_frame_irq += periods * APU_FRAME_PERIOD;
+  }
+  _cycles = now;
+}
+
+uint64_t APU::next_event() const {
+  if (_five_step || _irq_inhibit || _frame_irq) {
+    return NO_EVENT;
+  }
+  return _next_frame_irq;
+}
+
+bool APU::irq() const { return _frame_irq; }
+
+void APU::save(StateWriter &writer) const {
+  writer.put(_cycles);
+  writer.put(_next_frame_irq);
+  writer.put<uint8_t>(_five_step);
+  writer.put<uint8_t>(_irq_inhibit);
+  writer.put<uint8_t>(_frame_irq);
+}
+
+void APU::load(StateReader &reader) {
+  _cycles = reader.get<uint64_t>();
+  _next_frame_irq = reader.get<uint64_t>();
+  _five_step = reader.get<uint8_t>() != 0;
+  _irq_inhibit = reader.get<uint8_t>() != 0;
+  _frame_irq = reader.get<uint8_t>() != 0;
+}
@@ -1,6 +1,48 @@
 #pragma once
+#include <cstdint>
 
+class StateReader;
+class StateWriter;
+
+/* CPU cycles from a $4017 write to the 4-step sequence's frame interrupt. */
+constexpr uint64_t APU_FRAME_IRQ_DELAY = 29829;
+/* Length of the 4-step frame sequence in CPU cycles (4 x 89490 / 12). */
+constexpr uint64_t APU_FRAME_PERIOD = 29830;
+
+/*
+ * Audio Processing Unit.
+ *
+ * Only the frame sequencer's interrupt is modelled so far. The APU is
+ * simulated lazily: catch_up() brings it forward to a CPU timestamp and
+ * next_event() reports when it will next raise IRQ. The Bus decides when
+ * to catch it up; the register accessors act on the state as it stands.
+ */
 class APU {
+private:
+  uint64_t _cycles; // CPU cycle the APU has been simulated up to
+  uint64_t _next_frame_irq; // CPU cycle the 4-step sequence next sets the frame interrupt
+  bool     _five_step; // $4017 bit 7: 5-step sequence, which never interrupts
+  bool     _irq_inhibit; // $4017 bit 6: frame interrupt disabled
+  bool     _frame_irq; // Frame interrupt flag ($4015 bit 6)
+
 public:
   APU();
+
+  /* Read $4015. Clears the frame interrupt flag. */
+  uint8_t  read_status();
+
+  /* Write $4017 at CPU cycle `now`. Restarts the frame sequencer. */
+  void     write_frame_counter(uint8_t data, uint64_t now);
+
+  /* Simulate forward to CPU cycle `now`. */
+  void     catch_up(uint64_t now);
+
+  /* CPU cycle of the next interrupt the APU will raise, or NO_EVENT. */
+  uint64_t next_event() const;
+
+  /* State of the APU's IRQ output. */
+  bool     irq() const;
+
+  void     save(StateWriter &writer) const;
+  void     load(StateReader &reader);
 };
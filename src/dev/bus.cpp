@@ -1,26 +1,139 @@
+#include <algorithm>
 #include <array>
 #include <cstdint>
-#include <iostream>
 
 #include "./bus.hpp"
+#include "../io/log.hpp"
+#include "../io/savestate.hpp"
 
 Bus::Bus() {
-  std::cout << "Bus initialized" << std::endl;
-  std::cout << "Bus size: " << sizeof(Bus) << std::endl;
-  _iram = std::make_unique<std::array<uint8_t, RAM_SIZE>>();
-  _iram->fill(0);
-  _ppu_rgstr.fill(0);
+  MP6502_LOG(LogLevel::Debug, "Bus initialized (%zu bytes)", sizeof(Bus));
+  _iram.fill(0);
   _apu_io_rgstr.fill(0);
   _apu_test_rgstr.fill(0);
+  _rd_pages.fill(nullptr);
+  _wr_pages.fill(nullptr);
+  _wr_dirty.fill(&_dirty_sink);
+  _iram_dirty.fill(0);
+  _dirty_sink = 0;
+  _base_id = 0;
+  _map_generation = 0;
+  _cycles = 0;
+  _deadline = 0;
+  _sync_mode = SyncMode::Batched;
+  /// $0000-$1FFF: the 2KB of internal RAM mirrored four times.
+  for (uint16_t mirror = 0x00; mirror < 0x20; mirror += RAM_SIZE / PAGE_SIZE) {
+    map_pages(mirror, RAM_SIZE / PAGE_SIZE, _iram.data(), true,
+              _iram_dirty.data());
+  }
 }
 
 Bus::~Bus() {}
 
-uint8_t Bus::read(uint16_t addr) {
+void Bus::map_pages(uint8_t first_page, uint16_t count, uint8_t *base,
+                    bool writable, uint8_t *dirty) {
+  for (uint16_t i = 0; i < count; i++) {
+    _rd_pages[first_page + i] = base + i * PAGE_SIZE;
+    _wr_pages[first_page + i] = writable ? base + i * PAGE_SIZE : nullptr;
+    _wr_dirty[first_page + i] = dirty != nullptr ? dirty + i : &_dirty_sink;
+  }
+  _map_generation++;
+}
+
+void Bus::map_pages(uint8_t first_page, uint16_t count, const uint8_t *base) {
+  for (uint16_t i = 0; i < count; i++) {
+    _rd_pages[first_page + i] = base + i * PAGE_SIZE;
+    _wr_pages[first_page + i] = nullptr;
+  }
+  _map_generation++;
+}
+
+void Bus::unmap_pages(uint8_t first_page, uint16_t count) {
+  for (uint16_t i = 0; i < count; i++) {
+    _rd_pages[first_page + i] = nullptr;
+    _wr_pages[first_page + i] = nullptr;
+  }
+  _map_generation++;
+}
+
+void Bus::catch_up() {
+  _apu.catch_up(_cycles);
+  _ppu.catch_up(_cycles);
+}
+uint64_t Bus::next_event() const {
+  return std::min(_apu.next_event(), _ppu.next_event());
+}
+bool     Bus::irq() const {
+  return _apu.irq() || (_mapper != nullptr && _mapper->irq());
+}
+
+void Bus::insert_cartridge(std::shared_ptr<const Reader> rom, void *storage) {
+  if (storage != nullptr && _mapper.get() == storage) {
+    unmap_pages(0x60, 0xA0);
+    _ppu.attach(nullptr);
+    _mapper.reset();
+  }
+  MapperPtr mapper = make_mapper(std::move(rom), storage);
+  _ppu.attach(mapper.get());
+  _mapper = std::move(mapper);
+  _mapper->attach(*this);
+}
+
+void Bus::save(StateWriter &writer) const {
+  writer.put<uint8_t>(_mapper != nullptr);
+  if (_mapper != nullptr) {
+    _mapper->save(writer);
+  }
+  writer.write_pages(_iram.data(), _iram_dirty.data(), _iram_dirty.size());
+  writer.write(_apu_io_rgstr.data(), _apu_io_rgstr.size());
+  writer.write(_apu_test_rgstr.data(), _apu_test_rgstr.size());
+  writer.put(_cycles);
+  _apu.save(writer);
+  _ppu.save(writer);
+}
+
+void Bus::load(StateReader &reader) {
+  bool has_mapper = reader.get<uint8_t>() != 0;
+  if (has_mapper != (_mapper != nullptr)) {
+    throw std::runtime_error("Save state is for a different cartridge");
+  }
+  if (_mapper != nullptr) {
+    _mapper->load(reader);
+  }
+  reader.read_pages(_iram.data(), _iram_dirty.data(), _iram_dirty.size());
+  reader.read(_apu_io_rgstr.data(), _apu_io_rgstr.size());
+  reader.read(_apu_test_rgstr.data(), _apu_test_rgstr.size());
+  _cycles = reader.get<uint64_t>();
+  /// End any batch in progress; the scheduler sets a fresh deadline.
+  _deadline = 0;
+  _apu.load(reader);
+  _ppu.load(reader);
+}
+
+void Bus::mark_clean(uint64_t base_id) {
+  _iram_dirty.fill(0);
+  if (_mapper != nullptr) {
+    _mapper->mark_clean();
+  }
+  _ppu.mark_clean();
+  _base_id = base_id;
+}
+
+/// Register accesses catch the device up in both sync modes, so Lockstep
+/// is never less exact than Batched.
+void Bus::sync_apu() { _apu.catch_up(_cycles); }
+
+void Bus::sync_ppu() { _ppu.catch_up(_cycles); }
+
+uint8_t Bus::read_io(uint16_t addr) {
   if (addr < 0x2000) {
-    return (*_iram)[addr & 0x07FF];
+    return _iram[addr & 0x07FF];
   } else if (addr < 0x4000) {
-    return _ppu_rgstr[addr & 0x0007];
+    sync_ppu();
+    return _ppu.read_register(addr & 0x0007);
+  } else if (addr == 0x4015) {
+    sync_apu();
+    return _apu.read_status();
   } else if (addr < 0x4018) {
     return _apu_io_rgstr[addr - 0x4000];
   } else if (addr < 0x4020) {
@@ -29,14 +142,39 @@ uint8_t Bus::read(uint16_t addr) {
   return 0;
 }
 
-void Bus::write(uint16_t addr, uint8_t data) {
+void Bus::write_io(uint16_t addr, uint8_t data) {
   if (addr < 0x2000) {
-    (*_iram)[addr & 0x07FF] = data;
+    _iram[addr & 0x07FF] = data;
+    _iram_dirty[(addr & 0x07FF) / PAGE_SIZE] = 1;
   } else if (addr < 0x4000) {
-    _ppu_rgstr[addr & 0x0007] = data;
+    sync_ppu();
+    _ppu.write_register(addr & 0x0007, data);
+    limit_deadline(_ppu.next_event());
+  } else if (addr == 0x4014) {
+    /// OAM DMA: the CPU stalls 513 cycles, 514 from an odd cycle.
+    _apu_io_rgstr[addr - 0x4000] = data;
+    uint8_t page[OAM_SIZE];
+    for (uint16_t i = 0; i < OAM_SIZE; i++) {
+      page[i] = read(data << 8 | i);
+    }
+    sync_ppu();
+    _ppu.write_oam_dma(page);
+    _cycles += 513 + (_cycles & 1);
   } else if (addr < 0x4018) {
     _apu_io_rgstr[addr - 0x4000] = data;
+    if (addr == 0x4017) {
+      sync_apu();
+      _apu.write_frame_counter(data, _cycles);
+      limit_deadline(_apu.next_event());
+    }
   } else if (addr < 0x4020) {
     _apu_test_rgstr[addr - 0x4018] = data;
+  } else if (_mapper != nullptr) {
+    /// Bank and IRQ registers change what the PPU fetches and when the
+    /// board interrupts, so bring the PPU up to this write first.
+    sync_ppu();
+    _mapper->write(addr, data);
+    _ppu.mapper_changed();
+    limit_deadline(_ppu.next_event());
   }
 }
@@ -1,16 +1,20 @@
 #pragma once
 #include "apu.hpp"
+#include "clock.hpp"
+#include "mapper.hpp"
+#include "ppu.hpp"
 #include <array>
 #include <cstdint>
-#include <iostream>
 #include <memory>
 
 constexpr uint16_t                                     RAM_SIZE = 2048;
-constexpr uint16_t                                     PPU_REG_SIZE = 8;
 constexpr uint16_t                                     APU_IO_REG_SIZE = 24;
 constexpr uint16_t                                     APU_TEST_REG_SIZE = 8;
+constexpr uint16_t                                     PAGE_SIZE = 0x100;
+constexpr uint16_t                                     PAGE_COUNT = 0x100;
 
-typedef std::unique_ptr<std::array<uint8_t, RAM_SIZE>> InternalRAM;
+typedef std::array<uint8_t, RAM_SIZE>                  InternalRAM;
+typedef std::array<uint8_t, RAM_SIZE / PAGE_SIZE>      DirtyPages;
 
 /*
  *                                      NES6502 Memory Map
@@ -35,18 +39,150 @@ typedef std::unique_ptr<std::array<uint8_t, RAM_SIZE>> InternalRAM;
  * |----------------|----------|-----------------------------------------------|-------------------|
  * | $4020-$FFFF    | $BFE0    | PRG ROM, PRG RAM, and mapper registers        |  Cartridge Space  |
  * +-----------------------------------------------------------------------------------------------+
+ *
+ * Reads and writes are decoded through a table with one entry per 256-byte
+ * page. Pages backed by plain memory (internal RAM and its mirrors, and
+ * whatever the cartridge maps) hold a direct host pointer, so an access is
+ * a single indexed load or store. Pages with side effects (PPU and APU/IO
+ * registers, mapper registers, unmapped cartridge space) hold nullptr and
+ * fall back to read_io()/write_io(). Bank switching only rewrites entries.
+ *
+ * Each writable page also points at a dirty flag for the memory behind it,
+ * which write() sets, so delta save states can copy only the pages written
+ * since the last full save or load. Pages nobody tracks share a sink flag.
+ *
+ * The Bus holds all of its memory by value and starts on a cache line with
+ * internal RAM, followed by the I/O registers, dirty flags and clock, so a
+ * Bus placed right after its CPU (see Machine) keeps the zero page, the
+ * stack and the CPU registers on neighbouring lines, and constructing one
+ * does not allocate.
  */
-class Bus {
+class alignas(64) Bus {
 private:
-  APU                                    _apu; // Audio Processing Unit
-  InternalRAM                            _iram; // 2KB internal RAM on heap
-  std::array<uint8_t, PPU_REG_SIZE>      _ppu_rgstr; // PPU registers
-  std::array<uint8_t, APU_IO_REG_SIZE>   _apu_io_rgstr; // APU I/O registers
-  std::array<uint8_t, APU_TEST_REG_SIZE> _apu_test_rgstr; // APU test registers
+  InternalRAM                             _iram; // 2KB internal RAM, first so it starts the block
+  std::array<uint8_t, APU_IO_REG_SIZE>    _apu_io_rgstr; // APU I/O registers
+  std::array<uint8_t, APU_TEST_REG_SIZE>  _apu_test_rgstr; // APU test registers
+  DirtyPages                              _iram_dirty;
+  uint8_t                                 _dirty_sink; // Dirty flag for untracked pages
+  SyncMode                                _sync_mode; // How the scheduler steps the devices
+  uint32_t                                _map_generation; // Bumped whenever the page table changes
+  uint64_t                                _cycles; // Master clock, in CPU cycles since power-on
+  uint64_t                                _deadline; // Clock value at which NES6502::run() hands back to the scheduler
+  uint64_t                                _base_id; // StateHeader::base_id of the state dirty flags are relative to
+  std::array<const uint8_t *, PAGE_COUNT> _rd_pages; // Readable page pointers
+  std::array<uint8_t *, PAGE_COUNT>       _wr_pages; // Writable page pointers
+  std::array<uint8_t *, PAGE_COUNT>       _wr_dirty; // Dirty flag of each writable page
+  APU                                     _apu; // Audio Processing Unit
+  MapperPtr                               _mapper; // Inserted cartridge, or nullptr
+  PPU                                     _ppu; // Picture Processing Unit, last: it holds the frame
+
+  /* Simulate the APU or PPU forward to the current access. */
+  void    sync_apu();
+  void    sync_ppu();
+
+  /* Slow path for pages without a direct pointer. */
+  uint8_t read_io(uint16_t addr);
+  void    write_io(uint16_t addr, uint8_t data);
 
 public:
   Bus();
   ~Bus();
   uint8_t read(uint16_t addr);
   void    write(uint16_t addr, uint8_t data);
-};
\ No newline at end of file
+
+  /* Point `count` pages starting at `first_page` at consecutive 256-byte
+   * blocks of `base`. Read-only memory (PRG ROM) passes writable = false,
+   * so writes to it still reach write_io() where mapper registers live.
+   * `dirty`, if given, holds one flag per page of `base` for write() to set.
+   */
+  void    map_pages(uint8_t first_page, uint16_t count, uint8_t *base,
+                    bool writable, uint8_t *dirty = nullptr);
+
+  /* Read-only variant for memory the Bus must never write (PRG ROM). */
+  void    map_pages(uint8_t first_page, uint16_t count, const uint8_t *base);
+
+  /* Route `count` pages starting at `first_page` back to the slow path. */
+  void    unmap_pages(uint8_t first_page, uint16_t count);
+
+  /* Build the board for `rom` and map its PRG ROM and PRG RAM into
+   * $6000-$FFFF. The board is allocated unless `storage` (see
+   * make_mapper()) is given, in which case it must outlive the Bus and any
+   * board previously built there is destroyed first. Throws
+   * std::runtime_error for unsupported mappers.
+   */
+  void    insert_cartridge(std::shared_ptr<const Reader> rom,
+                           void                         *storage = nullptr);
+  Mapper *get_mapper() { return _mapper.get(); }
+  PPU    &get_ppu() { return _ppu; }
+
+  /* Master clock. The CPU advances it after every instruction; devices
+   * use it to timestamp register accesses.
+   */
+  uint64_t get_cycles() const { return _cycles; }
+  void     tick(uint8_t cycles) { _cycles += cycles; }
+
+  /* End of the CPU's current batch. A register write that moves a device
+   * event earlier pulls it in with limit_deadline().
+   */
+  uint64_t get_deadline() const { return _deadline; }
+  void     set_deadline(uint64_t deadline) { _deadline = deadline; }
+  void     limit_deadline(uint64_t deadline) {
+    if (deadline < _deadline) {
+      _deadline = deadline;
+    }
+  }
+
+  SyncMode get_sync_mode() const { return _sync_mode; }
+  void     set_sync_mode(SyncMode mode) { _sync_mode = mode; }
+
+  /* Simulate every device forward to the master clock. */
+  void     catch_up();
+
+  /* Earliest timestamp at which a device will raise an interrupt, or NO_EVENT. */
+  uint64_t next_event() const;
+
+  /* State of the shared (level-triggered) IRQ line. */
+  bool     irq() const;
+
+  /* Whether the PPU has raised NMI (edge-triggered) since the last call. */
+  bool     take_nmi() { return _ppu.take_nmi(); }
+
+  /* Save or restore memory, registers, the clock and every device. The
+   * cartridge section comes first so load() can reject a state from
+   * another cartridge (std::runtime_error) before changing anything.
+   */
+  void     save(StateWriter &writer) const;
+  void     load(StateReader &reader);
+
+  /* Clear every dirty flag, making the current state the base that delta
+   * save states are taken against, identified by `base_id`.
+   */
+  void     mark_clean(uint64_t base_id);
+  uint64_t get_base_id() const { return _base_id; }
+
+  /* Direct pointer to a readable page, or nullptr if it has side effects. */
+  const uint8_t *get_read_page(uint8_t page) const { return _rd_pages[page]; }
+
+  /* Changes every time map_pages()/unmap_pages() is called, so anything
+   * caching a page pointer (the CPU's opcode fetch) can tell it is stale.
+   */
+  uint32_t get_map_generation() const { return _map_generation; }
+};
+
+inline uint8_t Bus::read(uint16_t addr) {
+  const uint8_t *page = _rd_pages[addr >> 8];
+  if (page != nullptr) {
+    return page[addr & 0x00FF];
+  }
+  return read_io(addr);
+}
+
+inline void Bus::write(uint16_t addr, uint8_t data) {
+  uint8_t *page = _wr_pages[addr >> 8];
+  if (page != nullptr) {
+    page[addr & 0x00FF] = data;
+    *_wr_dirty[addr >> 8] = 1;
+    return;
+  }
+  write_io(addr, data);
+}
\ No newline at end of file
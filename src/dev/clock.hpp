@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+/*
+ * System timing.
+ *
+ * Every device timestamp is a count of CPU cycles since power-on, kept by
+ * the Bus. Devices are simulated forward to a timestamp on demand and
+ * report the timestamp of their next externally visible event so the
+ * scheduler knows how far the CPU may run ahead of them.
+ */
+
+/* Timestamp for "nothing scheduled". */
+constexpr uint64_t NO_EVENT = UINT64_MAX;
+
+/* NTSC: 341 dots x 262 scanlines, minus the dot skipped on odd frames,
+ * at 3 PPU dots per CPU cycle, gives 29780.5 CPU cycles per frame.
+ */
+constexpr uint64_t CPU_CYCLES_PER_TWO_FRAMES = 59561;
+
+enum class SyncMode {
+  /* Run the CPU uninterrupted up to the next predicted device event, then
+   * bring the devices up to date. In between, a device is only simulated
+   * forward when the CPU reads or writes one of its registers. Fastest;
+   * used for headless batch runs.
+   */
+  Batched,
+  /* As Batched for register accesses, but also bring the devices up to
+   * date and poll interrupts after every instruction. Slower, but
+   * interrupt latency matches hardware, which the timing test ROMs check.
+   */
+  Lockstep,
+};
@@ -0,0 +1,462 @@
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "./bus.hpp"
+#include "./mapper.hpp"
+#include "../io/savestate.hpp"
+
+Mapper::Mapper(std::shared_ptr<const Reader> rom) : _rom(std::move(rom)) {
+  _bus = nullptr;
+  _mirroring = _rom->get_header().mirroring;
+  _prg_ram_enabled = false;
+  _prg_ram_writable = false;
+  _prg_ram.fill(0);
+  _chr_ram.fill(0);
+  _chr_ram_rows.fill(0);
+  _prg_ram_dirty.fill(0);
+  _chr_ram_dirty.fill(0);
+  _chr_rd_pages.fill(nullptr);
+  _chr_wr_pages.fill(nullptr);
+  _chr_row_pages.fill(nullptr);
+}
+
+Mapper::~Mapper() {}
+
+void Mapper::attach(Bus &bus) {
+  _bus = &bus;
+  map_prg_ram(true, true);
+  reset();
+}
+
+void     Mapper::clock_scanline() {}
+uint32_t Mapper::scanlines_until_irq() const { return NO_SCANLINE_IRQ; }
+
+bool Mapper::irq() const { return false; }
+
+void Mapper::save_regs(StateWriter &) const {}
+void Mapper::load_regs(StateReader &) {}
+
+void Mapper::save(StateWriter &writer) const {
+  const RomHeader &header = _rom->get_header();
+  writer.put(header.mapper);
+  writer.put<uint32_t>(header.prg_rom_size);
+  writer.put<uint32_t>(header.chr_rom_size);
+  writer.put<uint8_t>(static_cast<uint8_t>(_mirroring));
+  writer.put<uint8_t>(_prg_ram_enabled);
+  writer.put<uint8_t>(_prg_ram_writable);
+  writer.write_pages(_prg_ram.data(), _prg_ram_dirty.data(),
+                     _prg_ram_dirty.size());
+  /// CHR ROM needs no saving; only boards with CHR RAM carry it.
+  if (header.chr_rom_size == 0) {
+    writer.write_pages(_chr_ram.data(), _chr_ram_dirty.data(),
+                       _chr_ram_dirty.size());
+  }
+  save_regs(writer);
+}
+
+void Mapper::load(StateReader &reader) {
+  const RomHeader &header = _rom->get_header();
+  uint16_t         mapper = reader.get<uint16_t>();
+  uint32_t         prg_rom_size = reader.get<uint32_t>();
+  uint32_t         chr_rom_size = reader.get<uint32_t>();
+  if (mapper != header.mapper || prg_rom_size != header.prg_rom_size ||
+      chr_rom_size != header.chr_rom_size) {
+    throw std::runtime_error("Save state is for a different cartridge");
+  }
+  _mirroring = static_cast<Mirroring>(reader.get<uint8_t>());
+  bool enabled = reader.get<uint8_t>() != 0;
+  bool writable = reader.get<uint8_t>() != 0;
+  reader.read_pages(_prg_ram.data(), _prg_ram_dirty.data(),
+                    _prg_ram_dirty.size());
+  if (header.chr_rom_size == 0) {
+    reader.read_pages(_chr_ram.data(), _chr_ram_dirty.data(),
+                      _chr_ram_dirty.size());
+    for (size_t offset = 0; offset < CHR_RAM_SIZE; offset += 16) {
+      for (size_t row = 0; row < 8; row++) {
+        decode_chr_ram(offset + row);
+      }
+    }
+  }
+  load_regs(reader);
+  map_prg_ram(enabled, writable);
+  apply();
+}
+
+void Mapper::map_prg(uint16_t addr, size_t size, int bank) {
+  RomSpan prg = _rom->get_prg();
+  size_t  banks = prg.size < size ? 1 : prg.size / size;
+  size_t  index = bank < 0 ? banks - (static_cast<size_t>(-bank) % banks)
+                           : static_cast<size_t>(bank);
+  /// A ROM smaller than the window (NROM-128 in a 32KB slot) is mirrored
+  /// by mapping it once per repeat.
+  size_t  chunk = prg.size < size ? prg.size : size;
+  for (size_t offset = 0; offset < size; offset += chunk) {
+    _bus->map_pages((addr + offset) >> 8, chunk / PAGE_SIZE,
+                    prg.data + (index % banks) * chunk);
+  }
+}
+
+void Mapper::map_chr(uint16_t addr, size_t size, int bank) {
+  RomSpan       chr = _rom->get_chr();
+  const ChrRow *rows = _rom->get_chr_rows();
+  bool          ram = chr.size == 0;
+  size_t        total = ram ? CHR_RAM_SIZE : chr.size;
+  size_t        banks = total < size ? 1 : total / size;
+  size_t        index = bank < 0 ? banks - (static_cast<size_t>(-bank) % banks)
+                                 : static_cast<size_t>(bank);
+  size_t        base = (index % banks) * size;
+  for (size_t offset = 0; offset < size; offset += CHR_PAGE_SIZE) {
+    size_t page = ((addr + offset) >> 10) & 0x07;
+    size_t src = (base + offset) % total;
+    if (ram) {
+      _chr_rd_pages[page] = _chr_ram.data() + src;
+      _chr_wr_pages[page] = _chr_ram.data() + src;
+      _chr_row_pages[page] = _chr_ram_rows.data() + src / 2;
+    } else {
+      _chr_rd_pages[page] = chr.data + src;
+      _chr_wr_pages[page] = nullptr;
+      _chr_row_pages[page] = rows + src / 2;
+    }
+  }
+}
+
+void Mapper::map_prg_ram(bool enabled, bool writable) {
+  _prg_ram_enabled = enabled;
+  _prg_ram_writable = writable;
+  if (enabled) {
+    _bus->map_pages(0x60, PRG_RAM_SIZE / PAGE_SIZE, _prg_ram.data(), writable,
+                    _prg_ram_dirty.data());
+  } else {
+    _bus->unmap_pages(0x60, PRG_RAM_SIZE / PAGE_SIZE);
+  }
+}
+
+void Mapper::mark_clean() {
+  _prg_ram_dirty.fill(0);
+  _chr_ram_dirty.fill(0);
+}
+
+/* NROM */
+
+void NROM::reset() { apply(); }
+
+void NROM::apply() {
+  map_prg(0x8000, 0x4000, 0);
+  map_prg(0xC000, 0x4000, -1);
+  map_chr(0x0000, 0x2000, 0);
+}
+
+void NROM::write(uint16_t, uint8_t) {}
+
+/* MMC1 */
+
+void MMC1::reset() {
+  _shift = 0;
+  _shift_count = 0;
+  _control = 0x0C;
+  _chr_bank0 = 0;
+  _chr_bank1 = 0;
+  _prg_bank = 0;
+  _last_write = NO_EVENT;
+  apply();
+}
+
+void MMC1::save_regs(StateWriter &writer) const {
+  writer.put(_shift);
+  writer.put(_shift_count);
+  writer.put(_control);
+  writer.put(_chr_bank0);
+  writer.put(_chr_bank1);
+  writer.put(_prg_bank);
+  writer.put(_last_write);
+}
+
+void MMC1::load_regs(StateReader &reader) {
+  _shift = reader.get<uint8_t>();
+  _shift_count = reader.get<uint8_t>();
+  _control = reader.get<uint8_t>();
+  _chr_bank0 = reader.get<uint8_t>();
+  _chr_bank1 = reader.get<uint8_t>();
+  _prg_bank = reader.get<uint8_t>();
+  _last_write = reader.get<uint64_t>();
+}
+
+void MMC1::write(uint16_t addr, uint8_t data) {
+  if (addr < 0x8000) {
+    return;
+  }
+  /// The serial port ignores a write on the cycle right after another one,
+  /// which is how the dummy write of a read-modify-write instruction lands.
+  uint64_t now = _bus->get_cycles();
+  bool     back_to_back = _last_write != NO_EVENT && now - _last_write <= 1;
+  _last_write = now;
+  if (back_to_back) {
+    return;
+  }
+  if (data & 0x80) {
+    _shift = 0;
+    _shift_count = 0;
+    _control |= 0x0C;
+    apply();
+    return;
+  }
+  _shift |= (data & 0x01) << _shift_count;
+  if (++_shift_count < 5) {
+    return;
+  }
+  switch ((addr >> 13) & 0x03) {
+  case 0:
+    _control = _shift;
+    break;
+  case 1:
+    _chr_bank0 = _shift;
+    break;
+  case 2:
+    _chr_bank1 = _shift;
+    break;
+  case 3:
+    _prg_bank = _shift;
+    break;
+  }
+  _shift = 0;
+  _shift_count = 0;
+  apply();
+}
+
+void MMC1::apply() {
+  switch (_control & 0x03) {
+  case 0:
+    _mirroring = Mirroring::SingleLower;
+    break;
+  case 1:
+    _mirroring = Mirroring::SingleUpper;
+    break;
+  case 2:
+    _mirroring = Mirroring::Vertical;
+    break;
+  case 3:
+    _mirroring = Mirroring::Horizontal;
+    break;
+  }
+
+  uint8_t prg = _prg_bank & 0x0F;
+  if (!(_control & 0x08)) {
+    map_prg(0x8000, 0x8000, prg >> 1);
+  } else if (!(_control & 0x04)) {
+    map_prg(0x8000, 0x4000, 0);
+    map_prg(0xC000, 0x4000, prg);
+  } else {
+    map_prg(0x8000, 0x4000, prg);
+    map_prg(0xC000, 0x4000, -1);
+  }
+
+  if (_control & 0x10) {
+    map_chr(0x0000, 0x1000, _chr_bank0);
+    map_chr(0x1000, 0x1000, _chr_bank1);
+  } else {
+    map_chr(0x0000, 0x2000, _chr_bank0 >> 1);
+  }
+
+  map_prg_ram(!(_prg_bank & 0x10), true);
+}
+
+/* UxROM */
+
+void UxROM::reset() {
+  _prg_bank = 0;
+  apply();
+}
+
+void UxROM::apply() {
+  map_prg(0x8000, 0x4000, _prg_bank);
+  map_prg(0xC000, 0x4000, -1);
+  map_chr(0x0000, 0x2000, 0);
+}
+
+void UxROM::save_regs(StateWriter &writer) const { writer.put(_prg_bank); }
+void UxROM::load_regs(StateReader &reader) {
+  _prg_bank = reader.get<uint8_t>();
+}
+
+void UxROM::write(uint16_t addr, uint8_t data) {
+  if (addr >= 0x8000) {
+    _prg_bank = data;
+    map_prg(0x8000, 0x4000, _prg_bank);
+  }
+}
+
+/* CNROM */
+
+void CNROM::reset() {
+  _chr_bank = 0;
+  apply();
+}
+
+void CNROM::apply() {
+  map_prg(0x8000, 0x4000, 0);
+  map_prg(0xC000, 0x4000, -1);
+  map_chr(0x0000, 0x2000, _chr_bank);
+}
+
+void CNROM::save_regs(StateWriter &writer) const { writer.put(_chr_bank); }
+void CNROM::load_regs(StateReader &reader) {
+  _chr_bank = reader.get<uint8_t>();
+}
+
+void CNROM::write(uint16_t addr, uint8_t data) {
+  if (addr >= 0x8000) {
+    _chr_bank = data;
+    map_chr(0x0000, 0x2000, _chr_bank);
+  }
+}
+
+/* MMC3 */
+
+void MMC3::reset() {
+  _bank_select = 0;
+  _banks = {0, 2, 4, 5, 6, 7, 0, 1};
+  _irq_latch = 0;
+  _irq_counter = 0;
+  _irq_enabled = false;
+  _irq_pending = false;
+  /// Four-screen boards use the WRAM chip as nametable RAM.
+  if (_mirroring == Mirroring::FourScreen) {
+    map_prg_ram(false, false);
+  }
+  apply();
+}
+
+void MMC3::save_regs(StateWriter &writer) const {
+  writer.put(_bank_select);
+  writer.write(_banks.data(), _banks.size());
+  writer.put(_irq_latch);
+  writer.put(_irq_counter);
+  writer.put<uint8_t>(_irq_enabled);
+  writer.put<uint8_t>(_irq_pending);
+}
+
+void MMC3::load_regs(StateReader &reader) {
+  _bank_select = reader.get<uint8_t>();
+  reader.read(_banks.data(), _banks.size());
+  _irq_latch = reader.get<uint8_t>();
+  _irq_counter = reader.get<uint8_t>();
+  _irq_enabled = reader.get<uint8_t>() != 0;
+  _irq_pending = reader.get<uint8_t>() != 0;
+}
+
+void MMC3::write(uint16_t addr, uint8_t data) {
+  if (addr < 0x8000) {
+    return;
+  }
+  bool odd = addr & 0x0001;
+  switch ((addr >> 13) & 0x03) {
+  case 0: // $8000 bank select / $8001 bank data
+    if (odd) {
+      _banks[_bank_select & 0x07] = data;
+    } else {
+      _bank_select = data;
+    }
+    apply();
+    break;
+  case 1: // $A000 mirroring / $A001 WRAM enable and protect
+    if (_mirroring == Mirroring::FourScreen) {
+      break;
+    }
+    if (odd) {
+      map_prg_ram(data & 0x80, !(data & 0x40));
+    } else {
+      _mirroring = data & 0x01 ? Mirroring::Horizontal : Mirroring::Vertical;
+    }
+    break;
+  case 2: // $C000 IRQ reload value / $C001 IRQ clear
+    if (odd) {
+      _irq_counter = 0;
+    } else {
+      _irq_latch = data;
+    }
+    break;
+  case 3: // $E000 IRQ acknowledge and disable / $E001 IRQ enable
+    _irq_enabled = odd;
+    if (!odd) {
+      _irq_pending = false;
+    }
+    break;
+  }
+}
+
+void MMC3::apply() {
+  if (_bank_select & 0x40) {
+    map_prg(0x8000, 0x2000, -2);
+    map_prg(0xC000, 0x2000, _banks[6]);
+  } else {
+    map_prg(0x8000, 0x2000, _banks[6]);
+    map_prg(0xC000, 0x2000, -2);
+  }
+  map_prg(0xA000, 0x2000, _banks[7]);
+  map_prg(0xE000, 0x2000, -1);
+
+  /// R0/R1 select 2KB banks in 1KB units, so the low bit is ignored.
+  uint16_t big = _bank_select & 0x80 ? 0x1000 : 0x0000;
+  uint16_t small = big ^ 0x1000;
+  map_chr(big + 0x0000, 0x0800, _banks[0] >> 1);
+  map_chr(big + 0x0800, 0x0800, _banks[1] >> 1);
+  for (uint8_t i = 0; i < 4; i++) {
+    map_chr(small + i * 0x0400, 0x0400, _banks[2 + i]);
+  }
+}
+
+void MMC3::clock_scanline() {
+  if (_irq_counter == 0) {
+    _irq_counter = _irq_latch;
+  } else if (--_irq_counter == 0 && _irq_enabled) {
+    _irq_pending = true;
+  }
+}
+
+uint32_t MMC3::scanlines_until_irq() const {
+  if (!_irq_enabled || _irq_pending) {
+    return NO_SCANLINE_IRQ;
+  }
+  if (_irq_counter != 0) {
+    return _irq_counter;
+  }
+  /// A zero counter reloads first; a zero latch keeps it at zero for good.
+  return _irq_latch != 0 ? _irq_latch + 1u : NO_SCANLINE_IRQ;
+}
+
+bool MMC3::irq() const { return _irq_pending; }
+
+void MapperDeleter::operator()(Mapper *mapper) const {
+  if (owned) {
+    delete mapper;
+  } else {
+    mapper->~Mapper();
+  }
+}
+
+template <typename T>
+static MapperPtr place_mapper(std::shared_ptr<const Reader> rom,
+                              void                         *storage) {
+  if (storage == nullptr) {
+    return MapperPtr(new T(std::move(rom)));
+  }
+  return MapperPtr(new (storage) T(std::move(rom)), MapperDeleter{false});
+}
+
+MapperPtr make_mapper(std::shared_ptr<const Reader> rom, void *storage) {
+  switch (rom->get_header().mapper) {
+  case 0:
+    return place_mapper<NROM>(std::move(rom), storage);
+  case 1:
+    return place_mapper<MMC1>(std::move(rom), storage);
+  case 2:
+    return place_mapper<UxROM>(std::move(rom), storage);
+  case 3:
+    return place_mapper<CNROM>(std::move(rom), storage);
+  case 4:
+    return place_mapper<MMC3>(std::move(rom), storage);
+  }
+  throw std::runtime_error("Unsupported mapper: " +
+                           std::to_string(rom->get_header().mapper));
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "../io/rom.hpp"
+#include "clock.hpp"
+
+class Bus;
+class StateReader;
+class StateWriter;
+
+constexpr size_t PRG_RAM_SIZE = 0x2000; // 8KB at $6000-$7FFF
+constexpr size_t CHR_RAM_SIZE = 0x2000; // 8KB
+constexpr size_t CHR_PAGE_SIZE = 0x0400; // 1KB, the finest CHR banking unit
+constexpr uint32_t NO_SCANLINE_IRQ = UINT32_MAX;
+
+/*
+ * Cartridge board.
+ *
+ * A mapper never sits on the CPU read path. Whenever its bank registers
+ * change it rewrites the Bus page table for $6000-$FFFF and its own
+ * 1KB CHR page table, so PRG fetches are the Bus's direct pointer loads
+ * and CHR fetches (chr_read) are an inline table lookup. Only register
+ * writes, which land on pages with no write pointer, reach the virtual
+ * write().
+ *
+ * CHR is also mapped pre-decoded (chr_row), one ChrRow per tile row: CHR
+ * ROM from the Reader's shared cache, CHR RAM from a copy that chr_write()
+ * re-decodes one row at a time, so the PPU never combines bitplanes itself.
+ */
+class Mapper {
+protected:
+  std::shared_ptr<const Reader>             _rom;
+  Bus                                      *_bus; // Bus whose page table the mapper maintains
+  Mirroring                                 _mirroring;
+  bool                                      _prg_ram_enabled;
+  bool                                      _prg_ram_writable;
+  std::array<uint8_t, PRG_RAM_SIZE>         _prg_ram;
+  std::array<uint8_t, CHR_RAM_SIZE>         _chr_ram; // Used when the cartridge has no CHR ROM
+  std::array<uint8_t, PRG_RAM_SIZE / 0x100> _prg_ram_dirty; // Per 256-byte page
+  std::array<uint8_t, CHR_RAM_SIZE / 0x100> _chr_ram_dirty;
+  std::array<ChrRow, CHR_RAM_SIZE / 2>      _chr_ram_rows; // _chr_ram decoded, kept in step by chr_write()
+  std::array<const uint8_t *, 8>            _chr_rd_pages; // PPU $0000-$1FFF in 1KB pages
+  std::array<uint8_t *, 8>                  _chr_wr_pages; // nullptr for CHR ROM
+  std::array<const ChrRow *, 8>             _chr_row_pages; // Decoded rows behind each _chr_rd_pages entry
+
+  /* Map `size` bytes at CPU address `addr` to PRG ROM bank `bank` of that size.
+   * Negative banks count back from the end of the ROM (-1 is the last bank).
+   */
+  void map_prg(uint16_t addr, size_t size, int bank);
+
+  /* Map `size` bytes at PPU address `addr` to CHR bank `bank` of that size. */
+  void map_chr(uint16_t addr, size_t size, int bank);
+
+  /* Re-decode the CHR RAM row whose plane 0 byte is at `offset`. */
+  void decode_chr_ram(size_t offset) {
+    _chr_ram_rows[(offset >> 4) * 8 + (offset & 0x07)] =
+        decode_chr_row(_chr_ram[offset], _chr_ram[offset + 8]);
+  }
+
+  /* Map or unmap PRG RAM at $6000-$7FFF. */
+  void map_prg_ram(bool enabled, bool writable);
+
+  /* Set up the power-on banks. */
+  virtual void reset() = 0;
+
+  /* Rebuild the PRG and CHR mappings from the bank registers. */
+  virtual void apply() = 0;
+
+  /* Board-specific registers, for save states. */
+  virtual void save_regs(StateWriter &writer) const;
+  virtual void load_regs(StateReader &reader);
+
+public:
+  Mapper(std::shared_ptr<const Reader> rom);
+  virtual ~Mapper();
+
+  /* Connect to `bus` and map the power-on banks into its page table. */
+  void         attach(Bus &bus);
+
+  /* CPU write to a cartridge address with no direct write pointer. */
+  virtual void write(uint16_t addr, uint8_t data) = 0;
+
+  /* Called by the PPU once per rendered scanline (MMC3 IRQ counter). */
+  virtual void clock_scanline();
+
+  /* clock_scanline() calls until the board raises IRQ, counting the one
+   * that does, or NO_SCANLINE_IRQ if it will not. Lets the PPU predict
+   * when to stop the CPU.
+   */
+  virtual uint32_t scanlines_until_irq() const;
+
+  /* State of the cartridge IRQ line. */
+  virtual bool irq() const;
+
+  Mirroring    get_mirroring() const { return _mirroring; }
+
+  /* Save or restore PRG RAM, CHR RAM and the bank registers. load()
+   * remaps the banks, and throws std::runtime_error if the state was
+   * saved from a different cartridge.
+   */
+  void         save(StateWriter &writer) const;
+  void         load(StateReader &reader);
+
+  /* Clear the PRG RAM and CHR RAM dirty flags. */
+  void         mark_clean();
+
+  uint8_t      chr_read(uint16_t addr) const {
+    return _chr_rd_pages[(addr >> 10) & 0x07][addr & 0x03FF];
+  }
+
+  /* Decoded tile row at pattern address `addr` (bit 3, the plane, ignored). */
+  ChrRow       chr_row(uint16_t addr) const {
+    return _chr_row_pages[(addr >> 10) & 0x07][(addr & 0x03F0) >> 1 |
+                                               (addr & 0x07)];
+  }
+
+  void chr_write(uint16_t addr, uint8_t data) {
+    uint8_t *page = _chr_wr_pages[(addr >> 10) & 0x07];
+    if (page != nullptr) {
+      page[addr & 0x03FF] = data;
+      size_t offset = page + (addr & 0x03FF) - _chr_ram.data();
+      _chr_ram_dirty[offset >> 8] = 1;
+      decode_chr_ram(offset & ~size_t{0x08});
+    }
+  }
+};
+
+/* Mapper 000. Fixed 16KB or 32KB PRG, fixed 8KB CHR. */
+class NROM final : public Mapper {
+protected:
+  void reset() override;
+  void apply() override;
+
+public:
+  using Mapper::Mapper;
+  void write(uint16_t addr, uint8_t data) override;
+};
+
+/* Mapper 001. Serial shift-register loaded PRG/CHR banking and mirroring. */
+class MMC1 final : public Mapper {
+private:
+  uint8_t  _shift; // Bits shifted in so far, LSB first
+  uint8_t  _shift_count;
+  uint8_t  _control; // $8000: CPPMM
+  uint8_t  _chr_bank0; // $A000
+  uint8_t  _chr_bank1; // $C000
+  uint8_t  _prg_bank; // $E000: RPPPP, R = PRG RAM disable
+  uint64_t _last_write; // Clock value of the last register write
+
+protected:
+  void reset() override;
+  void apply() override;
+  void save_regs(StateWriter &writer) const override;
+  void load_regs(StateReader &reader) override;
+
+public:
+  using Mapper::Mapper;
+  void write(uint16_t addr, uint8_t data) override;
+};
+
+/* Mapper 002. Switchable 16KB PRG at $8000, last bank fixed at $C000. */
+class UxROM final : public Mapper {
+private:
+  uint8_t _prg_bank;
+
+protected:
+  void reset() override;
+  void apply() override;
+  void save_regs(StateWriter &writer) const override;
+  void load_regs(StateReader &reader) override;
+
+public:
+  using Mapper::Mapper;
+  void write(uint16_t addr, uint8_t data) override;
+};
+
+/* Mapper 003. Fixed PRG, switchable 8KB CHR. */
+class CNROM final : public Mapper {
+private:
+  uint8_t _chr_bank;
+
+protected:
+  void reset() override;
+  void apply() override;
+  void save_regs(StateWriter &writer) const override;
+  void load_regs(StateReader &reader) override;
+
+public:
+  using Mapper::Mapper;
+  void write(uint16_t addr, uint8_t data) override;
+};
+
+/* Mapper 004. 8KB PRG / 1-2KB CHR banking and a scanline IRQ counter. */
+class MMC3 final : public Mapper {
+private:
+  uint8_t                _bank_select; // $8000: CP...AAA
+  std::array<uint8_t, 8> _banks; // R0-R7
+  uint8_t                _irq_latch;
+  uint8_t                _irq_counter;
+  bool                   _irq_enabled;
+  bool                   _irq_pending;
+
+protected:
+  void reset() override;
+  void apply() override;
+  void save_regs(StateWriter &writer) const override;
+  void load_regs(StateReader &reader) override;
+
+public:
+  using Mapper::Mapper;
+  void write(uint16_t addr, uint8_t data) override;
+  void     clock_scanline() override;
+  uint32_t scanlines_until_irq() const override;
+  bool     irq() const override;
+};
+
+/* Size and alignment of storage that fits any supported board. */
+constexpr size_t MAPPER_STORAGE_SIZE =
+    std::max({sizeof(NROM), sizeof(MMC1), sizeof(UxROM), sizeof(CNROM),
+              sizeof(MMC3)});
+constexpr size_t MAPPER_STORAGE_ALIGN =
+    std::max({alignof(NROM), alignof(MMC1), alignof(UxROM), alignof(CNROM),
+              alignof(MMC3)});
+
+/* Destroys a board, and frees it unless it was built in caller storage. */
+struct MapperDeleter {
+  bool owned = true;
+  void operator()(Mapper *mapper) const;
+};
+typedef std::unique_ptr<Mapper, MapperDeleter> MapperPtr;
+
+/* Create the board for `rom`'s mapper number, on the heap or, if given,
+ * in `storage` (MAPPER_STORAGE_SIZE bytes aligned to MAPPER_STORAGE_ALIGN).
+ * Throws std::runtime_error for unsupported mappers.
+ */
+MapperPtr make_mapper(std::shared_ptr<const Reader> rom,
+                      void                         *storage = nullptr);
@@ -1,293 +1,225 @@
 #include "./nes6502.hpp"
 #include "./bus.hpp"
+#include "../io/log.hpp"
+#include "../io/savestate.hpp"
 #include <cassert>
 #include <cstdint>
-#include <iostream>
 #include <stdckdint.h>
-#include <vector>
+#include <stdexcept>
 
-NES6502::NES6502() {
+/*
+ * The opcode table is constant-initialised, so it is built by the compiler
+ * and shared by every NES6502 instance instead of being allocated and filled
+ * in each constructor.
+ */
+constexpr std::array<NES6502::Instruction, 256> NES6502::instr = {{
+#define NES6502_OPCODE(code, mode, op, cycles)                                 \
+  {code, &NES6502::fused<&NES6502::mode, &NES6502::op>, cycles},
+#include "./opcodes.inc"
+#undef NES6502_OPCODE
+}};
+
+#ifdef MP6502_DISPATCH_BASELINE
+const std::vector<NES6502::MemberInstruction> NES6502::member_instr = {
+#define NES6502_OPCODE(code, mode, op, cycles)                                 \
+  {&NES6502::mode, &NES6502::op, cycles},
+#include "./opcodes.inc"
+#undef NES6502_OPCODE
+};
+#endif
+
+NES6502::NES6502(Bus &bus) : bus(bus) {
   pc = 0x0000;
-  stp = 0xFF;
+  /// Power-on SP is 0x00; the first reset's three suppressed pushes bring
+  /// it to 0xFD.
+  stp = 0x00;
   acc = 0;
   irx = 0;
   iry = 0;
-  pstat_r.reset();
-  instr = {
-      {0x00,  &NES6502::IMM,     &NES6502::BRK, 7},
-      {0x01, &NES6502::INDX,     &NES6502::ORA, 6},
-      {0x02,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x03, &NES6502::INDX, &NES6502::INVALID, 8},
-      {0x04,  &NES6502::ZP0, &NES6502::INVALID, 3},
-      {0x05,  &NES6502::ZP0,     &NES6502::ORA, 3},
-      {0x06,  &NES6502::ZP0,     &NES6502::ASL, 5},
-      {0x07,  &NES6502::ZP0, &NES6502::INVALID, 5},
-      {0x08,  &NES6502::IMP,     &NES6502::PHP, 3},
-      {0x09,  &NES6502::IMM,     &NES6502::ORA, 2},
-      {0x0A,  &NES6502::ACC,     &NES6502::ASL, 2},
-      {0x0B,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0x0C,  &NES6502::ABS, &NES6502::INVALID, 4},
-      {0x0D,  &NES6502::ABS,     &NES6502::ORA, 4},
-      {0x0E,  &NES6502::ABS,     &NES6502::ASL, 6},
-      {0x0F,  &NES6502::ABS, &NES6502::INVALID, 6},
-      {0x10,  &NES6502::REL,     &NES6502::BPL, 2},
-      {0x11, &NES6502::INDY,     &NES6502::ORA, 5},
-      {0x12,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x13, &NES6502::INDY, &NES6502::INVALID, 8},
-      {0x14,  &NES6502::ZPX, &NES6502::INVALID, 4},
-      {0x15,  &NES6502::ZPX,     &NES6502::ORA, 4},
-      {0x16,  &NES6502::ZPX,     &NES6502::ASL, 6},
-      {0x17,  &NES6502::ZPX, &NES6502::INVALID, 6},
-      {0x18,  &NES6502::IMP,     &NES6502::CLC, 2},
-      {0x19, &NES6502::ABSY,     &NES6502::ORA, 4},
-      {0x1A,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x1B, &NES6502::ABSY, &NES6502::INVALID, 7},
-      {0x1C, &NES6502::ABSX, &NES6502::INVALID, 4},
-      {0x1D, &NES6502::ABSX,     &NES6502::ORA, 4},
-      {0x1E, &NES6502::ABSX,     &NES6502::ASL, 7},
-      {0x1F, &NES6502::ABSX, &NES6502::INVALID, 7},
-      {0x20,  &NES6502::ABS,     &NES6502::JSR, 6},
-      {0x21, &NES6502::INDX,     &NES6502::AND, 6},
-      {0x22,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x23, &NES6502::INDX, &NES6502::INVALID, 8},
-      {0x24,  &NES6502::ZP0,     &NES6502::BIT, 3},
-      {0x25,  &NES6502::ZP0,     &NES6502::AND, 3},
-      {0x26,  &NES6502::ZP0,     &NES6502::ROL, 5},
-      {0x27,  &NES6502::ZP0, &NES6502::INVALID, 5},
-      {0x28,  &NES6502::IMP,     &NES6502::PLP, 4},
-      {0x29,  &NES6502::IMM,     &NES6502::AND, 2},
-      {0x2A,  &NES6502::ACC,     &NES6502::ROL, 2},
-      {0x2B,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0x2C,  &NES6502::ABS,     &NES6502::BIT, 4},
-      {0x2D,  &NES6502::ABS,     &NES6502::AND, 4},
-      {0x2E,  &NES6502::ABS,     &NES6502::ROL, 6},
-      {0x2F,  &NES6502::ABS, &NES6502::INVALID, 6},
-      {0x30,  &NES6502::REL,     &NES6502::BMI, 2},
-      {0x31, &NES6502::INDY,     &NES6502::AND, 5},
-      {0x32,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x33, &NES6502::INDY, &NES6502::INVALID, 8},
-      {0x34,  &NES6502::ZPX, &NES6502::INVALID, 4},
-      {0x35,  &NES6502::ZPX,     &NES6502::AND, 4},
-      {0x36,  &NES6502::ZPX,     &NES6502::ROL, 6},
-      {0x37,  &NES6502::ZPX, &NES6502::INVALID, 6},
-      {0x38,  &NES6502::IMP,     &NES6502::SEC, 2},
-      {0x39, &NES6502::ABSY,     &NES6502::AND, 4},
-      {0x3A,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x3B, &NES6502::ABSY, &NES6502::INVALID, 7},
-      {0x3C, &NES6502::ABSX, &NES6502::INVALID, 4},
-      {0x3D, &NES6502::ABSX,     &NES6502::AND, 4},
-      {0x3E, &NES6502::ABSX,     &NES6502::ROL, 7},
-      {0x3F, &NES6502::ABSX, &NES6502::INVALID, 7},
-      {0x40,  &NES6502::IMP,     &NES6502::RTI, 6},
-      {0x41, &NES6502::INDX,     &NES6502::EOR, 6},
-      {0x42,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x43, &NES6502::INDX, &NES6502::INVALID, 8},
-      {0x44,  &NES6502::ZP0, &NES6502::INVALID, 3},
-      {0x45,  &NES6502::ZP0,     &NES6502::EOR, 3},
-      {0x46,  &NES6502::ZP0,     &NES6502::LSR, 5},
-      {0x47,  &NES6502::ZP0, &NES6502::INVALID, 5},
-      {0x48,  &NES6502::IMP,     &NES6502::PHA, 3},
-      {0x49,  &NES6502::IMM,     &NES6502::EOR, 2},
-      {0x4A,  &NES6502::ACC,     &NES6502::LSR, 2},
-      {0x4B,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0x4C,  &NES6502::ABS,     &NES6502::JMP, 3},
-      {0x4D,  &NES6502::ABS,     &NES6502::EOR, 4},
-      {0x4E,  &NES6502::ABS,     &NES6502::LSR, 6},
-      {0x4F,  &NES6502::ABS, &NES6502::INVALID, 6},
-      {0x50,  &NES6502::REL,     &NES6502::RTS, 2},
-      {0x51, &NES6502::INDY,     &NES6502::EOR, 5},
-      {0x52,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x53, &NES6502::INDY, &NES6502::INVALID, 8},
-      {0x54,  &NES6502::ZPX, &NES6502::INVALID, 4},
-      {0x55,  &NES6502::ZPX,     &NES6502::EOR, 4},
-      {0x56,  &NES6502::ZPX,     &NES6502::LSR, 6},
-      {0x57,  &NES6502::ZPX, &NES6502::INVALID, 6},
-      {0x58,  &NES6502::IMP,     &NES6502::CLI, 2},
-      {0x59, &NES6502::ABSY,     &NES6502::EOR, 4},
-      {0x5A,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x5B, &NES6502::ABSY, &NES6502::INVALID, 7},
-      {0x5C, &NES6502::ABSX, &NES6502::INVALID, 4},
-      {0x5D, &NES6502::ABSX,     &NES6502::EOR, 4},
-      {0x5E, &NES6502::ABSX,     &NES6502::LSR, 7},
-      {0x5F, &NES6502::ABSX, &NES6502::INVALID, 7},
-      {0x60,  &NES6502::IMP,     &NES6502::RTS, 6},
-      {0x61, &NES6502::INDX,     &NES6502::ADC, 6},
-      {0x62,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x63, &NES6502::INDX, &NES6502::INVALID, 8},
-      {0x64,  &NES6502::ZP0, &NES6502::INVALID, 3},
-      {0x65,  &NES6502::ZP0,     &NES6502::ADC, 3},
-      {0x66,  &NES6502::ZP0,     &NES6502::ROL, 5},
-      {0x67,  &NES6502::ZP0, &NES6502::INVALID, 5},
-      {0x68,  &NES6502::IMP,     &NES6502::PLA, 4},
-      {0x69,  &NES6502::IMM,     &NES6502::ADC, 2},
-      {0x6A,  &NES6502::ACC,     &NES6502::ROR, 2},
-      {0x6B,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0x6C,  &NES6502::IND,     &NES6502::JMP, 5},
-      {0x6D,  &NES6502::ABS,     &NES6502::ADC, 4},
-      {0x6E,  &NES6502::ABS,     &NES6502::ROL, 6},
-      {0x6F,  &NES6502::ABS, &NES6502::INVALID, 6},
-      {0x70,  &NES6502::REL,     &NES6502::BVS, 2},
-      {0x71, &NES6502::INDY,     &NES6502::ADC, 5},
-      {0x72,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x73, &NES6502::INDY, &NES6502::INVALID, 8},
-      {0x74,  &NES6502::ZPX, &NES6502::INVALID, 4},
-      {0x75,  &NES6502::ZPX,     &NES6502::ADC, 4},
-      {0x76,  &NES6502::ZPX,     &NES6502::ROL, 6},
-      {0x77,  &NES6502::ZPX, &NES6502::INVALID, 6},
-      {0x78,  &NES6502::IMP,     &NES6502::SEI, 2},
-      {0x79, &NES6502::ABSY,     &NES6502::ADC, 4},
-      {0x7A,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x7B, &NES6502::ABSY, &NES6502::INVALID, 7},
-      {0x7C, &NES6502::ABSX, &NES6502::INVALID, 4},
-      {0x7D, &NES6502::ABSX,     &NES6502::ADC, 4},
-      {0x7E, &NES6502::ABSX,     &NES6502::ROL, 7},
-      {0x7F, &NES6502::ABSX, &NES6502::INVALID, 7},
-      {0x80,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0x81, &NES6502::INDX,     &NES6502::STA, 6},
-      {0x82,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0x83, &NES6502::INDX, &NES6502::INVALID, 6},
-      {0x84,  &NES6502::ZP0,     &NES6502::STY, 3},
-      {0x85,  &NES6502::ZP0,     &NES6502::STA, 3},
-      {0x86,  &NES6502::ZP0,     &NES6502::STX, 3},
-      {0x87,  &NES6502::ZP0, &NES6502::INVALID, 3},
-      {0x88,  &NES6502::IMP,     &NES6502::DEY, 2},
-      {0x89,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0x8A,  &NES6502::IMP,     &NES6502::TXA, 2},
-      {0x8B,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0x8C,  &NES6502::ABS,     &NES6502::STY, 4},
-      {0x8D,  &NES6502::ABS,     &NES6502::STA, 4},
-      {0x8E,  &NES6502::ABS,     &NES6502::STX, 4},
-      {0x8F,  &NES6502::ABS, &NES6502::INVALID, 4},
-      {0x90,  &NES6502::REL,     &NES6502::BCC, 2},
-      {0x91, &NES6502::INDY,     &NES6502::STA, 6},
-      {0x92,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0x93, &NES6502::INDY, &NES6502::INVALID, 6},
-      {0x94,  &NES6502::ZPX,     &NES6502::STY, 4},
-      {0x95,  &NES6502::ZPX,     &NES6502::STA, 4},
-      {0x96,  &NES6502::ZPY,     &NES6502::STX, 4},
-      {0x97,  &NES6502::ZPY, &NES6502::INVALID, 4},
-      {0x98,  &NES6502::IMP,     &NES6502::TYA, 2},
-      {0x99, &NES6502::ABSY,     &NES6502::STA, 5},
-      {0x9A,  &NES6502::IMP,     &NES6502::TXS, 2},
-      {0x9B, &NES6502::ABSY, &NES6502::INVALID, 5},
-      {0x9C, &NES6502::ABSX, &NES6502::INVALID, 5},
-      {0x9D, &NES6502::ABSX,     &NES6502::STA, 5},
-      {0x9E, &NES6502::ABSY, &NES6502::INVALID, 5},
-      {0x9F, &NES6502::ABSY, &NES6502::INVALID, 5},
-      {0xA0,  &NES6502::IMM,     &NES6502::LDY, 2},
-      {0xA1, &NES6502::INDX,     &NES6502::LDA, 6},
-      {0xA2,  &NES6502::IMM,     &NES6502::LDX, 2},
-      {0xA3, &NES6502::INDX, &NES6502::INVALID, 6},
-      {0xA4,  &NES6502::ZP0,     &NES6502::LDY, 3},
-      {0xA5,  &NES6502::ZP0,     &NES6502::LDA, 3},
-      {0xA6,  &NES6502::ZP0,     &NES6502::LDX, 3},
-      {0xA7,  &NES6502::ZP0, &NES6502::INVALID, 3},
-      {0xA8,  &NES6502::IMP,     &NES6502::TAY, 2},
-      {0xA9,  &NES6502::IMM,     &NES6502::LDA, 2},
-      {0xAA,  &NES6502::IMP,     &NES6502::TAX, 2},
-      {0xAB,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0xAC,  &NES6502::ABS,     &NES6502::LDY, 4},
-      {0xAD,  &NES6502::ABS,     &NES6502::LDA, 4},
-      {0xAE,  &NES6502::ABS,     &NES6502::LDX, 4},
-      {0xAF,  &NES6502::ABS, &NES6502::INVALID, 4},
-      {0xB0,  &NES6502::REL,     &NES6502::BCC, 2},
-      {0xB1, &NES6502::INDY,     &NES6502::LDA, 5},
-      {0xB2,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0xB3, &NES6502::INDY, &NES6502::INVALID, 5},
-      {0xB4,  &NES6502::ZPX,     &NES6502::LDY, 4},
-      {0xB5,  &NES6502::ZPX,     &NES6502::LDA, 4},
-      {0xB6,  &NES6502::ZPY,     &NES6502::LDX, 4},
-      {0xB7,  &NES6502::ZPY, &NES6502::INVALID, 4},
-      {0xB8,  &NES6502::IMP,     &NES6502::CLV, 2},
-      {0xB9, &NES6502::ABSY,     &NES6502::LDA, 4},
-      {0xBA,  &NES6502::IMP,     &NES6502::TSX, 2},
-      {0xBB, &NES6502::ABSY, &NES6502::INVALID, 4},
-      {0xBC, &NES6502::ABSX,     &NES6502::LDY, 4},
-      {0xBD, &NES6502::ABSX,     &NES6502::LDA, 4},
-      {0xBE, &NES6502::ABSY,     &NES6502::LDX, 4},
-      {0xBF, &NES6502::ABSY, &NES6502::INVALID, 4},
-      {0xC0,  &NES6502::IMM,     &NES6502::CPY, 2},
-      {0xC1, &NES6502::INDX,     &NES6502::CMP, 6},
-      {0xC2,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0xC3, &NES6502::INDX, &NES6502::INVALID, 8},
-      {0xC4,  &NES6502::ZP0,     &NES6502::CPY, 3},
-      {0xC5,  &NES6502::ZP0,     &NES6502::CMP, 3},
-      {0xC6,  &NES6502::ZP0,     &NES6502::DEC, 5},
-      {0xC7,  &NES6502::ZP0, &NES6502::INVALID, 5},
-      {0xC8,  &NES6502::IMP,     &NES6502::INY, 2},
-      {0xC9,  &NES6502::IMM,     &NES6502::CMP, 2},
-      {0xCA,  &NES6502::IMP,     &NES6502::DEX, 2},
-      {0xCB,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0xCC,  &NES6502::ABS,     &NES6502::CPY, 4},
-      {0xCD,  &NES6502::ABS,     &NES6502::CMP, 4},
-      {0xCE,  &NES6502::ABS,     &NES6502::DEC, 6},
-      {0xCF,  &NES6502::ABS, &NES6502::INVALID, 6},
-      {0xD0,  &NES6502::REL,     &NES6502::BNE, 2},
-      {0xD1, &NES6502::INDY,     &NES6502::CMP, 5},
-      {0xD2,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0xD3, &NES6502::INDY, &NES6502::INVALID, 8},
-      {0xD4,  &NES6502::ZPX, &NES6502::INVALID, 4},
-      {0xD5,  &NES6502::ZPX,     &NES6502::CMP, 4},
-      {0xD6,  &NES6502::ZPX,     &NES6502::DEC, 6},
-      {0xD7,  &NES6502::ZPX, &NES6502::INVALID, 6},
-      {0xD8,  &NES6502::IMP,     &NES6502::CLD, 2},
-      {0xD9, &NES6502::ABSY,     &NES6502::CMP, 4},
-      {0xDA,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0xDB, &NES6502::ABSY, &NES6502::INVALID, 7},
-      {0xDC, &NES6502::ABSX, &NES6502::INVALID, 4},
-      {0xDD, &NES6502::ABSX,     &NES6502::CMP, 4},
-      {0xDE, &NES6502::ABSX,     &NES6502::DEC, 7},
-      {0xDF, &NES6502::ABSX, &NES6502::INVALID, 7},
-      {0xE0,  &NES6502::IMM,     &NES6502::CPY, 2},
-      {0xE1, &NES6502::INDX,     &NES6502::EOR, 6},
-      {0xE2,  &NES6502::IMM,     &NES6502::SBC, 2},
-      {0xE3, &NES6502::INDX, &NES6502::INVALID, 8},
-      {0xE4,  &NES6502::ZP0,     &NES6502::CPX, 3},
-      {0xE5,  &NES6502::ZP0,     &NES6502::SBC, 3},
-      {0xE6,  &NES6502::ZP0,     &NES6502::INC, 5},
-      {0xE7,  &NES6502::ZP0, &NES6502::INVALID, 5},
-      {0xE8,  &NES6502::IMP,     &NES6502::INX, 2},
-      {0xE9,  &NES6502::IMM,     &NES6502::SBC, 2},
-      {0xEA,  &NES6502::IMP,     &NES6502::NOP, 2},
-      {0xEB,  &NES6502::IMM, &NES6502::INVALID, 2},
-      {0xEC,  &NES6502::ABS,     &NES6502::CPY, 4},
-      {0xED,  &NES6502::ABS,     &NES6502::SBC, 4},
-      {0xEE,  &NES6502::ABS,     &NES6502::INC, 6},
-      {0xEF,  &NES6502::ABS, &NES6502::INVALID, 6},
-      {0xF0,  &NES6502::REL,     &NES6502::BEQ, 2},
-      {0xF1, &NES6502::INDY,     &NES6502::SBC, 5},
-      {0xF2,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0xF3, &NES6502::INDY, &NES6502::INVALID, 8},
-      {0xF4,  &NES6502::ZPX, &NES6502::INVALID, 4},
-      {0xF5,  &NES6502::ZPX,     &NES6502::SBC, 4},
-      {0xF6,  &NES6502::ZPX,     &NES6502::INC, 6},
-      {0xF7,  &NES6502::ZPX, &NES6502::INVALID, 6},
-      {0xF8,  &NES6502::IMP,     &NES6502::SED, 2},
-      {0xF9, &NES6502::ABSY,     &NES6502::SBC, 4},
-      {0xFA,  &NES6502::IMP, &NES6502::INVALID, 2},
-      {0xFB, &NES6502::ABSY, &NES6502::INVALID, 7},
-      {0xFC, &NES6502::ABSX, &NES6502::INVALID, 4},
-      {0xFD, &NES6502::ABSX,     &NES6502::SBC, 4},
-      {0xFE, &NES6502::ABSX,     &NES6502::INC, 7},
-      {0xFF, &NES6502::ABSX, &NES6502::INVALID, 7},
-  };
-  std::cout << "NES6502 initialized" << std::endl;
-}
-
-NES6502::~NES6502() { std::cout << "NES6502 destroyed" << std::endl; }
-
-/**
- * Check if there is an overflow condition for the operation a - b = result.
- *
- * @param a First operand
- * @param b Second operand
- * @param result Result of the operation
+  page_crossed = false;
+  extra_cycles = 0;
+  acc_mode = false;
+  code_page = nullptr;
+  code_page_hi = 0;
+  code_page_gen = 0;
+  fetch_stats = {0, 0};
+  instructions = 0;
+  set_status(0x00);
+  MP6502_LOG(LogLevel::Debug, "NES6502 initialized");
+}
+
+NES6502::~NES6502() { MP6502_LOG(LogLevel::Debug, "NES6502 destroyed"); }
+
+void NES6502::reset() {
+  pc = read16(0xFFFC);
+  stp -= 3;
+  set_interrupt_disable(true);
+  bus.tick(7);
+}
+
+void NES6502::save(StateWriter &writer) const {
+  bus.save(writer);
+  writer.put(pc);
+  writer.put(stp);
+  writer.put(acc);
+  writer.put(irx);
+  writer.put(iry);
+  writer.put(get_status());
+}
+
+void NES6502::load(StateReader &reader) {
+  bus.load(reader);
+  pc = reader.get<uint16_t>();
+  stp = reader.get<uint8_t>();
+  acc = reader.get<uint8_t>();
+  irx = reader.get<uint8_t>();
+  iry = reader.get<uint8_t>();
+  set_status(reader.get<uint8_t>());
+  /// Bank switches on load bump the map generation, but drop the cached
+  /// code page anyway so nothing survives from before the restore.
+  code_page = nullptr;
+}
+
+void NES6502::nmi() { interrupt(0xFFFA); }
+
+bool NES6502::irq() {
+  if (get_interrupt_disable()) {
+    return false;
+  }
+  interrupt(0xFFFE);
+  return true;
+}
+
+void NES6502::end_batch() {
+  /// Clearing I can unmask an IRQ that is already being held, which the
+  /// scheduler only notices between batches, so stop after this instruction.
+  if (!get_interrupt_disable()) {
+    bus.limit_deadline(0);
+  }
+}
+
+void NES6502::interrupt(uint16_t vector) {
+  push_stk(pc >> 8);
+  push_stk(pc & 0xFF);
+  push_stk((get_status() & ~FLAG_BREAK) | FLAG_UNUSED);
+  set_interrupt_disable(true);
+  pc = read16(vector);
+  bus.tick(7);
+}
+
+uint8_t NES6502::step() {
+  opcode = read_pc8();
+  instructions++;
+  const Instruction &ins = instr[opcode];
+  page_crossed = false;
+  extra_cycles = 0;
+  /// Advance the clock to the instruction's last cycle before running it, so
+  /// a register access inside it is timestamped when it actually happens.
+  bus.tick(ins.cycles - 1);
+  ins.exec(*this);
+  bus.tick(1 + extra_cycles);
+  return ins.cycles + extra_cycles;
+}
+
+#ifdef MP6502_DISPATCH_BASELINE
+uint8_t NES6502::step_baseline() {
+  opcode = read_pc8();
+  instructions++;
+  const MemberInstruction &ins = member_instr[opcode];
+  page_crossed = false;
+  extra_cycles = 0;
+  bus.tick(ins.cycles - 1);
+  (this->*ins.mode)();
+  (this->*ins.op)();
+  bus.tick(1 + extra_cycles);
+  return ins.cycles + extra_cycles;
+}
+#endif
+
+#if defined(MP6502_THREADED_CORE) && defined(__GNUC__)
+
+/*
+ * Threaded core. Every opcode gets its own label that runs the same fused
+ * handler as the opcode table, then fetches and jumps to the next opcode
+ * itself, so each opcode's indirect jump is predicted separately instead
+ * of all of them funnelling through the one call in step().
  */
-static bool check_overflow(uint8_t a, uint8_t b, uint8_t result) {
-  return (a & 0x80) != (b & 0x80) && (a & 0x80) != (result & 0x80);
+uint64_t NES6502::run(uint64_t budget) {
+  static const void *const labels[256] = {
+#define NES6502_OPCODE(code, mode, op, cycles) &&op_##code,
+#include "./opcodes.inc"
+#undef NES6502_OPCODE
+  };
+  uint64_t start = bus.get_cycles();
+  bus.set_deadline(start + budget);
+
+#define DISPATCH()                                                             \
+  if (bus.get_cycles() >= bus.get_deadline()) {                                \
+    return bus.get_cycles() - start;                                           \
+  }                                                                            \
+  opcode = read_pc8();                                                         \
+  instructions++;                                                              \
+  page_crossed = false;                                                        \
+  extra_cycles = 0;                                                            \
+  goto *labels[opcode];
+
+  DISPATCH();
+#define NES6502_OPCODE(code, mode, op, cycles)                                 \
+  op_##code : bus.tick(cycles - 1);                                            \
+  fused<&NES6502::mode, &NES6502::op>(*this);                                  \
+  bus.tick(1 + extra_cycles);                                                  \
+  DISPATCH();
+#include "./opcodes.inc"
+#undef NES6502_OPCODE
+#undef DISPATCH
+
+  return bus.get_cycles() - start;
+}
+
+#else
+
+uint64_t NES6502::run(uint64_t budget) {
+  uint64_t start = bus.get_cycles();
+  bus.set_deadline(start + budget);
+  while (bus.get_cycles() < bus.get_deadline()) {
+    step();
+  }
+  return bus.get_cycles() - start;
+}
+
+#endif
+
+Bus       &NES6502::get_bus() { return bus; }
+const Bus &NES6502::get_bus() const { return bus; }
+uint16_t NES6502::get_pc() const { return pc; }
+uint8_t  NES6502::get_acc() const { return acc; }
+uint8_t  NES6502::get_irx() const { return irx; }
+uint8_t  NES6502::get_iry() const { return iry; }
+uint8_t  NES6502::get_stp() const { return stp; }
+void     NES6502::set_pc(uint16_t addr) { pc = addr; }
+uint64_t NES6502::get_instructions() const { return instructions; }
+
+const NES6502::FetchStats &NES6502::get_fetch_stats() const {
+  return fetch_stats;
 }
 
 uint8_t NES6502::read_pc8() {
+  /// Code nearly always runs from PRG ROM or RAM, so keep a pointer to the
+  /// current page and only go back to the bus when pc leaves it or the
+  /// bus remaps (a mapper bank switch).
+  if ((pc >> 8) == code_page_hi && code_page != nullptr &&
+      code_page_gen == bus.get_map_generation()) {
+    fetch_stats.hits++;
+    return code_page[pc++ & 0x00FF];
+  }
+  return read_pc8_slow();
+}
+
+uint8_t NES6502::read_pc8_slow() {
+  fetch_stats.misses++;
+  code_page_hi = pc >> 8;
+  code_page_gen = bus.get_map_generation();
+  code_page = bus.get_read_page(code_page_hi);
   uint8_t byte = bus.read(pc);
   pc++;
   return byte;
@@ -308,43 +240,96 @@ uint16_t NES6502::read16(uint16_t addr) {
 
 uint16_t NES6502::read16_zp(uint16_t zp_addr) {
   assert((zp_addr & 0x00FF) == zp_addr);
-  uint8_t  wrapped_addr = static_cast<uint8_t>(zp_addr + 1);
-  uint8_t  zp_lo = read8(zp_addr);
-  uint8_t  zp_hi = read8(static_cast<uint16_t>(wrapped_addr));
-  uint16_t addr =
-      static_cast<uint16_t>(zp_hi) << 8 | static_cast<uint16_t>(zp_lo);
-  return read16(addr);
+  uint8_t wrapped_addr = static_cast<uint8_t>(zp_addr + 1);
+  uint8_t zp_lo = read8(zp_addr);
+  uint8_t zp_hi = read8(static_cast<uint16_t>(wrapped_addr));
+  return static_cast<uint16_t>(zp_hi) << 8 | static_cast<uint16_t>(zp_lo);
+}
+
+uint8_t NES6502::fetch() {
+  extra_cycles += page_crossed;
+  return read8(abs_addr);
+}
+
+uint8_t NES6502::fetch_rmw() {
+  fetched_data = acc_mode ? acc : read8(abs_addr);
+  return fetched_data;
+}
+
+void NES6502::store_rmw(uint8_t data) {
+  if (acc_mode) {
+    acc = data;
+    acc_mode = false;
+  } else {
+    write(abs_addr, data);
+  }
 }
 
 void NES6502::write(uint16_t addr, uint8_t data) { bus.write(addr, data); }
 
 void NES6502::push_stk(uint8_t data) {
-  bus.write(stp, data);
+  bus.write(0x0100 | stp, data);
   stp--;
 }
 
 uint8_t NES6502::pop_stk() {
   stp++;
-  return bus.read(stp);
+  return bus.read(0x0100 | stp);
+}
+
+void NES6502::add_with_carry(uint8_t data) {
+  uint16_t sum = acc + data + get_carry();
+  set_carry_from(sum);
+  set_overflow_from((acc ^ sum) & (data ^ sum));
+  acc = static_cast<uint8_t>(sum);
+  set_zn(acc);
+}
+
+void NES6502::compare(uint8_t reg) {
+  uint8_t data = fetch();
+  /// reg + ~data + 1 carries out of bit 7 exactly when reg >= data.
+  uint16_t diff = reg + (data ^ 0xFF) + 1;
+  set_carry_from(diff);
+  set_zn(static_cast<uint8_t>(diff));
+}
+
+void NES6502::branch(bool cond) {
+  if (!cond) {
+    return;
+  }
+  uint16_t target = pc + static_cast<int8_t>(rel_addr);
+  extra_cycles += 1 + ((target & 0xFF00) != (pc & 0xFF00));
+  pc = target;
 }
 
 /* Addressing Modes */
 
 void NES6502::ABS() { abs_addr = read_pc16(); }
 
-void NES6502::ABSX() { abs_addr = read_pc16() + irx; }
+void NES6502::ABSX() {
+  uint16_t base = read_pc16();
+  abs_addr = base + irx;
+  page_crossed = (abs_addr & 0xFF00) != (base & 0xFF00);
+}
 
-void NES6502::ABSY() { abs_addr = read_pc16() + iry; }
+void NES6502::ABSY() {
+  uint16_t base = read_pc16();
+  abs_addr = base + iry;
+  page_crossed = (abs_addr & 0xFF00) != (base & 0xFF00);
+}
 
-void NES6502::ACC() { throw std::runtime_error("ACC not implemented"); }
+void NES6502::ACC() { acc_mode = true; }
 
-void NES6502::IMM() { fetched_data = read_pc8(); }
+void NES6502::IMM() { abs_addr = pc++; }
 
-void NES6502::IMP() { throw std::runtime_error("IMP not implemented"); }
+void NES6502::IMP() {}
 
 void NES6502::IND() {
   uint16_t ind_addr = read_pc16();
-  abs_addr = read16(ind_addr);
+  /// The high byte is fetched without carrying into the page, so
+  /// JMP ($xxFF) reads its high byte from $xx00.
+  uint16_t hi_addr = (ind_addr & 0xFF00) | ((ind_addr + 1) & 0x00FF);
+  abs_addr = static_cast<uint16_t>(read8(hi_addr)) << 8 | read8(ind_addr);
 }
 
 void NES6502::INDX() {
@@ -355,8 +340,9 @@ void NES6502::INDX() {
 
 void NES6502::INDY() {
   uint8_t  operand = read_pc8();
-  uint16_t addr = read16_zp(operand);
-  abs_addr = addr + iry;
+  uint16_t base = read16_zp(operand);
+  abs_addr = base + iry;
+  page_crossed = (abs_addr & 0xFF00) != (base & 0xFF00);
 }
 
 void NES6502::REL() {
@@ -374,19 +360,19 @@ void NES6502::ZPY() { abs_addr = static_cast<uint8_t>(read_pc8() + iry); }
 // Load/Store Operations
 
 uint8_t NES6502::LDA() {
-  acc = read8(abs_addr);
+  acc = fetch();
   set_zn(acc);
   return acc;
 }
 
 uint8_t NES6502::LDX() {
-  irx = read8(abs_addr);
+  irx = fetch();
   set_zn(irx);
   return irx;
 }
 
 uint8_t NES6502::LDY() {
-  iry = read8(abs_addr);
+  iry = fetch();
   set_zn(iry);
   return iry;
 }
@@ -450,7 +436,8 @@ uint8_t NES6502::PHA() {
 }
 
 uint8_t NES6502::PHP() {
-  uint8_t pstat = static_cast<uint8_t>(pstat_r.to_ulong());
+  /// PHP always pushes the status with the Break and Unused bits set.
+  uint8_t pstat = get_status() | FLAG_BREAK | FLAG_UNUSED;
   push_stk(pstat);
   return pstat;
 }
@@ -463,221 +450,247 @@ uint8_t NES6502::PLA() {
 
 uint8_t NES6502::PLP() {
   uint8_t pstat = pop_stk();
-  pstat_r = std::bitset<8>(pstat);
+  set_status((pstat & ~FLAG_BREAK) | FLAG_UNUSED);
+  end_batch();
   return pstat;
 }
 
 // Bitwise Operations
 
 uint8_t NES6502::AND() {
-  acc = acc & read8(abs_addr);
+  acc = acc & fetch();
   set_zn(acc);
   return acc;
 }
 
 uint8_t NES6502::EOR() {
-  acc = acc ^ read8(abs_addr);
+  acc = acc ^ fetch();
   set_zn(acc);
   return acc;
 }
 
 uint8_t NES6502::ORA() {
-  acc = acc | read8(abs_addr);
+  acc = acc | fetch();
   set_zn(acc);
   return acc;
 }
 
 uint8_t NES6502::BIT() {
-  uint8_t value = acc & read8(abs_addr);
-  set_zn(value);
-  set_overflow(value & 0x40);
+  uint8_t data = read8(abs_addr);
+  uint8_t value = acc & data;
+  set_zero(value == 0);
+  set_overflow_from(data << 1);
+  set_negative(data & 0x80);
   return value;
 }
 
 // Arithmetic Operations
 
+/// The 2A03 has no decimal mode, so ADC and SBC ignore the D flag.
 uint8_t NES6502::ADC() {
-  throw std::runtime_error("ADC not implemented");
-  uint8_t data = read8(abs_addr);
-  uint8_t result = acc + data + get_carry();
-  set_carry(result < acc || result < data);
-  set_overflow(result < acc || result < data);
-  set_zn(result);
-  acc = result & 0xFF;
+  add_with_carry(fetch());
   return acc;
 }
 
 uint8_t NES6502::SBC() {
-  uint8_t old_acc = acc;
-  uint8_t data = read8(abs_addr);
-  uint8_t interm = acc - data;
-  uint8_t result = interm - (1 - get_carry());
-
-  set_carry(!(check_overflow(acc, data, interm) |
-              check_overflow(interm, 1 - get_carry(), result)));
-  set_overflow(check_overflow(old_acc, data, result));
-  set_zn(result);
-  acc = result;
-  return result;
+  /// A - M - (1 - C) == A + ~M + C
+  add_with_carry(~fetch());
+  return acc;
 }
 
 uint8_t NES6502::CMP() {
-  uint8_t data = read8(abs_addr);
-  uint8_t result = acc - data;
-  set_carry(acc < data);
-  set_zn(result);
-  return result;
+  compare(acc);
+  return acc;
 }
 
 uint8_t NES6502::CPX() {
-  throw std::runtime_error("CPX not implemented");
-  return 0;
+  compare(irx);
+  return irx;
 }
 
 uint8_t NES6502::CPY() {
-  throw std::runtime_error("CPY not implemented");
-  return 0;
+  compare(iry);
+  return iry;
 }
 
 // Increment/Decrement Operations
 
 uint8_t NES6502::INC() {
-  throw std::runtime_error("INC not implemented");
-  return 0;
+  uint8_t result = read8(abs_addr) + 1;
+  write(abs_addr, result);
+  set_zn(result);
+  return result;
 }
 uint8_t NES6502::INX() {
-  throw std::runtime_error("INX not implemented");
-  return 0;
+  irx++;
+  set_zn(irx);
+  return irx;
 }
 uint8_t NES6502::INY() {
-  throw std::runtime_error("INY not implemented");
-  return 0;
+  iry++;
+  set_zn(iry);
+  return iry;
 }
 uint8_t NES6502::DEC() {
-  throw std::runtime_error("DEC not implemented");
-  return 0;
+  uint8_t result = read8(abs_addr) - 1;
+  write(abs_addr, result);
+  set_zn(result);
+  return result;
 }
 uint8_t NES6502::DEX() {
-  throw std::runtime_error("DEX not implemented");
-  return 0;
+  irx--;
+  set_zn(irx);
+  return irx;
 }
 uint8_t NES6502::DEY() {
-  throw std::runtime_error("DEY not implemented");
-  return 0;
+  iry--;
+  set_zn(iry);
+  return iry;
 }
 
 // Shift Operations
 
 uint8_t NES6502::ASL() {
-  throw std::runtime_error("ASL not implemented");
-  return 0;
+  uint8_t data = fetch_rmw();
+  uint16_t shifted = data << 1;
+  uint8_t  result = static_cast<uint8_t>(shifted);
+  set_carry_from(shifted);
+  set_zn(result);
+  store_rmw(result);
+  return result;
 }
 uint8_t NES6502::LSR() {
-  throw std::runtime_error("LSR not implemented");
-  return 0;
+  uint8_t data = fetch_rmw();
+  uint8_t result = data >> 1;
+  set_carry_from(data << 8);
+  set_zn(result);
+  store_rmw(result);
+  return result;
 }
 uint8_t NES6502::ROL() {
-  throw std::runtime_error("ROL not implemented");
-  return 0;
+  uint8_t data = fetch_rmw();
+  uint16_t shifted = (data << 1) | get_carry();
+  uint8_t  result = static_cast<uint8_t>(shifted);
+  set_carry_from(shifted);
+  set_zn(result);
+  store_rmw(result);
+  return result;
 }
 uint8_t NES6502::ROR() {
-  throw std::runtime_error("ROR not implemented");
-  return 0;
+  uint8_t data = fetch_rmw();
+  uint8_t result = (data >> 1) | (get_carry() << 7);
+  set_carry_from(data << 8);
+  set_zn(result);
+  store_rmw(result);
+  return result;
 }
 
 // Jump Operations
 
 uint8_t NES6502::JMP() {
-  throw std::runtime_error("JMP not implemented");
+  pc = abs_addr;
   return 0;
 }
 uint8_t NES6502::JSR() {
-  throw std::runtime_error("JSR not implemented");
+  uint16_t ret = pc - 1;
+  push_stk(ret >> 8);
+  push_stk(ret & 0xFF);
+  pc = abs_addr;
   return 0;
 }
 uint8_t NES6502::RTS() {
-  throw std::runtime_error("RTS not implemented");
+  uint16_t lo = pop_stk();
+  uint16_t hi = pop_stk();
+  pc = (hi << 8 | lo) + 1;
   return 0;
 }
 
 // Branching
 
 uint8_t NES6502::BCC() {
-  throw std::runtime_error("BCC not implemented");
+  branch(!get_carry());
   return 0;
 }
 uint8_t NES6502::BCS() {
-  throw std::runtime_error("BCS not implemented");
+  branch(get_carry());
   return 0;
 }
 uint8_t NES6502::BEQ() {
-  throw std::runtime_error("BEQ not implemented");
+  branch(get_zero());
   return 0;
 }
 uint8_t NES6502::BMI() {
-  throw std::runtime_error("BMI not implemented");
+  branch(get_negative());
   return 0;
 }
 uint8_t NES6502::BNE() {
-  throw std::runtime_error("BNE not implemented");
+  branch(!get_zero());
   return 0;
 }
 uint8_t NES6502::BPL() {
-  throw std::runtime_error("BPL not implemented");
+  branch(!get_negative());
   return 0;
 }
 uint8_t NES6502::BVC() {
-  throw std::runtime_error("BVC not implemented");
+  branch(!get_overflow());
   return 0;
 }
 uint8_t NES6502::BVS() {
-  throw std::runtime_error("BVS not implemented");
+  branch(get_overflow());
   return 0;
 }
 
 // Status Flag Changes
 
 uint8_t NES6502::CLC() {
-  throw std::runtime_error("CLC not implemented");
+  set_carry(false);
   return 0;
 }
 uint8_t NES6502::CLD() {
-  throw std::runtime_error("CLD not implemented");
+  set_decimal_mode(false);
   return 0;
 }
 uint8_t NES6502::CLI() {
-  throw std::runtime_error("CLI not implemented");
+  set_interrupt_disable(false);
+  end_batch();
   return 0;
 }
 uint8_t NES6502::CLV() {
-  throw std::runtime_error("CLV not implemented");
+  set_overflow(false);
   return 0;
 }
 uint8_t NES6502::SEC() {
-  throw std::runtime_error("SEC not implemented");
+  set_carry(true);
   return 0;
 }
 uint8_t NES6502::SED() {
-  throw std::runtime_error("SED not implemented");
+  set_decimal_mode(true);
   return 0;
 }
 uint8_t NES6502::SEI() {
-  throw std::runtime_error("SEI not implemented");
+  set_interrupt_disable(true);
   return 0;
 }
 
 // System Functions
 
 uint8_t NES6502::BRK() {
-  throw std::runtime_error("BRK not implemented");
-  return 0;
-}
-uint8_t NES6502::NOP() {
-  throw std::runtime_error("NOP not implemented");
+  /// BRK is encoded as a 2 byte instruction; the IMM addressing mode has
+  /// already skipped the padding byte, so pc is the return address.
+  push_stk(pc >> 8);
+  push_stk(pc & 0xFF);
+  push_stk(get_status() | FLAG_BREAK | FLAG_UNUSED);
+  set_interrupt_disable(true);
+  pc = read16(0xFFFE);
   return 0;
 }
+uint8_t NES6502::NOP() { return 0; }
 uint8_t NES6502::RTI() {
-  throw std::runtime_error("RTI not implemented");
+  set_status((pop_stk() & ~FLAG_BREAK) | FLAG_UNUSED);
+  end_batch();
+  uint16_t lo = pop_stk();
+  uint16_t hi = pop_stk();
+  pc = hi << 8 | lo;
   return 0;
 }
 
@@ -688,27 +701,95 @@ uint8_t NES6502::INVALID() {
   return 0;
 }
 
-void    NES6502::set_carry(bool flag) { pstat_r.set(0, flag); }
-void    NES6502::set_zero(bool flag) { pstat_r.set(1, flag); }
-void    NES6502::set_interrupt_disable(bool flag) { pstat_r.set(2, flag); }
-void    NES6502::set_decimal_mode(bool flag) { pstat_r.set(3, flag); }
-void    NES6502::set_break(bool flag) { pstat_r.set(4, flag); }
-void    NES6502::set_unused(bool flag) { pstat_r.set(5, flag); }
-void    NES6502::set_overflow(bool flag) { pstat_r.set(6, flag); }
-void    NES6502::set_negative(bool flag) { pstat_r.set(7, flag); }
+/*
+ * Flag operations.
+ *
+ * I, D, B and the unused bit always live in pstat_r. With MP6502_LAZY_FLAGS,
+ * N, Z, C and V are kept as the raw values the last instruction produced and
+ * only turned into bits when something reads them: a branch, PHP, BRK, an
+ * interrupt push or get_status().
+ */
 
-uint8_t NES6502::get_carry() { return pstat_r.test(0) ? 1 : 0; }
-uint8_t NES6502::get_zero() { return pstat_r.test(1) ? (1 << 1) : 0; }
-uint8_t NES6502::get_interrupt_disable() {
-  return pstat_r.test(2) ? (1 << 2) : 0;
+static void assign_bit(uint8_t &reg, uint8_t bit, bool flag) {
+  reg = flag ? (reg | bit) : (reg & ~bit);
 }
-uint8_t NES6502::get_decimal_mode() { return pstat_r.test(3) ? (1 << 3) : 0; }
-uint8_t NES6502::get_break() { return pstat_r.test(4) ? (1 << 4) : 0; }
-uint8_t NES6502::get_unused() { return pstat_r.test(5) ? (1 << 5) : 0; }
-uint8_t NES6502::get_overflow() { return pstat_r.test(6) ? (1 << 6) : 0; }
-uint8_t NES6502::get_negative() { return pstat_r.test(7) ? (1 << 7) : 0; }
+
+void NES6502::set_interrupt_disable(bool flag) {
+  assign_bit(pstat_r, FLAG_INTERRUPT, flag);
+}
+void NES6502::set_decimal_mode(bool flag) {
+  assign_bit(pstat_r, FLAG_DECIMAL, flag);
+}
+void NES6502::set_break(bool flag) { assign_bit(pstat_r, FLAG_BREAK, flag); }
+void NES6502::set_unused(bool flag) { assign_bit(pstat_r, FLAG_UNUSED, flag); }
+
+uint8_t NES6502::get_interrupt_disable() const {
+  return pstat_r & FLAG_INTERRUPT;
+}
+uint8_t NES6502::get_decimal_mode() const { return pstat_r & FLAG_DECIMAL; }
+uint8_t NES6502::get_break() const { return pstat_r & FLAG_BREAK; }
+uint8_t NES6502::get_unused() const { return pstat_r & FLAG_UNUSED; }
+
+#ifdef MP6502_LAZY_FLAGS
+
+void    NES6502::set_carry(bool flag) { flag_c = flag ? 0x100 : 0; }
+void    NES6502::set_zero(bool flag) { flag_z = flag ? 0 : 1; }
+void    NES6502::set_overflow(bool flag) { flag_v = flag ? 0x80 : 0; }
+void    NES6502::set_negative(bool flag) { flag_n = flag ? 0x80 : 0; }
+void    NES6502::set_carry_from(uint16_t result) { flag_c = result; }
+void    NES6502::set_overflow_from(uint8_t bits) { flag_v = bits; }
 
 void    NES6502::set_zn(uint8_t val) {
-  set_zero(val == 0);
-  set_negative(val & 0x80);
+  flag_z = val;
+  flag_n = val;
+}
+
+uint8_t NES6502::get_carry() const { return (flag_c >> 8) & 1; }
+uint8_t NES6502::get_zero() const { return flag_z == 0 ? FLAG_ZERO : 0; }
+uint8_t NES6502::get_overflow() const { return (flag_v & 0x80) >> 1; }
+uint8_t NES6502::get_negative() const { return flag_n & FLAG_NEGATIVE; }
+
+uint8_t NES6502::get_status() const {
+  return (pstat_r & (FLAG_INTERRUPT | FLAG_DECIMAL | FLAG_BREAK | FLAG_UNUSED)) |
+         get_carry() | get_zero() | get_overflow() | get_negative();
+}
+
+void NES6502::set_status(uint8_t status) {
+  pstat_r = status;
+  set_carry(status & FLAG_CARRY);
+  set_zero(status & FLAG_ZERO);
+  set_overflow(status & FLAG_OVERFLOW);
+  set_negative(status & FLAG_NEGATIVE);
 }
+
+#else
+
+void NES6502::set_carry(bool flag) { assign_bit(pstat_r, FLAG_CARRY, flag); }
+void NES6502::set_zero(bool flag) { assign_bit(pstat_r, FLAG_ZERO, flag); }
+void NES6502::set_overflow(bool flag) {
+  assign_bit(pstat_r, FLAG_OVERFLOW, flag);
+}
+void NES6502::set_negative(bool flag) {
+  assign_bit(pstat_r, FLAG_NEGATIVE, flag);
+}
+void NES6502::set_carry_from(uint16_t result) {
+  pstat_r = (pstat_r & ~FLAG_CARRY) | ((result >> 8) & FLAG_CARRY);
+}
+void NES6502::set_overflow_from(uint8_t bits) {
+  pstat_r = (pstat_r & ~FLAG_OVERFLOW) | ((bits & 0x80) >> 1);
+}
+
+void NES6502::set_zn(uint8_t val) {
+  pstat_r = (pstat_r & ~(FLAG_ZERO | FLAG_NEGATIVE)) |
+            (val == 0 ? FLAG_ZERO : 0) | (val & FLAG_NEGATIVE);
+}
+
+uint8_t NES6502::get_carry() const { return pstat_r & FLAG_CARRY; }
+uint8_t NES6502::get_zero() const { return pstat_r & FLAG_ZERO; }
+uint8_t NES6502::get_overflow() const { return pstat_r & FLAG_OVERFLOW; }
+uint8_t NES6502::get_negative() const { return pstat_r & FLAG_NEGATIVE; }
+
+uint8_t NES6502::get_status() const { return pstat_r; }
+void    NES6502::set_status(uint8_t status) { pstat_r = status; }
+
+#endif
@@ -1,16 +1,95 @@
 #pragma once
-#include <iostream>
 
 #include "./bus.hpp"
-#include <bitset>
+#include <array>
 #include <cstdint>
 #include <vector>
 
+/* Processor status register bits. */
+constexpr uint8_t FLAG_CARRY = 1 << 0;
+constexpr uint8_t FLAG_ZERO = 1 << 1;
+constexpr uint8_t FLAG_INTERRUPT = 1 << 2;
+constexpr uint8_t FLAG_DECIMAL = 1 << 3;
+constexpr uint8_t FLAG_BREAK = 1 << 4;
+constexpr uint8_t FLAG_UNUSED = 1 << 5;
+constexpr uint8_t FLAG_OVERFLOW = 1 << 6;
+constexpr uint8_t FLAG_NEGATIVE = 1 << 7;
+
 class NES6502 {
 public:
-  NES6502();
+  explicit NES6502(Bus &bus);
   ~NES6502();
 
+  /* Load pc from the reset vector at $FFFC, set the interrupt disable flag
+   * and move SP down by three, as the hardware's suppressed pushes do
+   * (0xFD after power-on).
+   */
+  void     reset();
+
+  /* Service a non-maskable interrupt (vector $FFFA). */
+  void     nmi();
+
+  /* Service a maskable interrupt (vector $FFFE) unless interrupts are disabled.
+   * Returns whether it was taken.
+   */
+  bool     irq();
+
+  /* Execute a single instruction.
+   * Returns the number of cycles it took, including page-crossing
+   * and branch penalties.
+   */
+  uint8_t  step();
+
+#ifdef MP6502_DISPATCH_BASELINE
+  /* step() dispatched the way it was before the opcode table was built at
+   * compile time: through a table filled at startup with an addressing
+   * mode and an operation member pointer per opcode, two indirect calls
+   * per instruction. Only for bench/cpu_dispatch to compare against.
+   */
+  uint8_t  step_baseline();
+#endif
+
+  /* Execute instructions until at least `budget` cycles have elapsed on the bus clock.
+   * Returns the number of cycles actually spent, which can overshoot the
+   * budget by the length of the final instruction.
+   *
+   * Building with MP6502_THREADED_CORE on GCC/Clang selects the
+   * computed-goto core; otherwise this loops over step(). Both run the
+   * same opcode handlers.
+   */
+  uint64_t run(uint64_t budget);
+
+  Bus       &get_bus();
+  const Bus &get_bus() const;
+  uint16_t   get_pc() const;
+  void       set_pc(uint16_t addr);
+  uint8_t    get_acc() const;
+  uint8_t    get_irx() const;
+  uint8_t    get_iry() const;
+  uint8_t    get_stp() const;
+
+  /* Opcode/operand fetches served from the cached code page (hits)
+   * versus ones that had to refill it or go through the bus (misses).
+   */
+  struct FetchStats {
+    uint64_t hits;
+    uint64_t misses;
+  };
+  const FetchStats &get_fetch_stats() const;
+
+  /* Instructions executed since construction, by step() or run(). */
+  uint64_t get_instructions() const;
+
+  /* The processor status register as PHP would see it (minus B and unused). */
+  uint8_t  get_status() const;
+  void     set_status(uint8_t status);
+
+  /* Save or restore the registers and the whole Bus. Used by
+   * save_state()/load_state().
+   */
+  void     save(StateWriter &writer) const;
+  void     load(StateReader &reader);
+
 private:
   /* Opcode. The current instruction being executed. */
   uint8_t opcode;
@@ -32,6 +111,20 @@ private:
   uint16_t abs_addr;
   /* Relative address */
   uint16_t rel_addr;
+  /* Direct pointer to the page pc is in, or nullptr if it must go through the bus. */
+  const uint8_t *code_page;
+  /* High byte of pc that code_page was looked up for. */
+  uint8_t        code_page_hi;
+  /* Bus map generation code_page was looked up in. */
+  uint32_t       code_page_gen;
+  FetchStats     fetch_stats;
+  uint64_t       instructions;
+  /* Set by the indexed addressing modes when the index carried into the high byte. */
+  bool     page_crossed;
+  /* Cycles added on top of the opcode table's base count by the current instruction. */
+  uint8_t  extra_cycles;
+  /* Set by the ACC addressing mode so shifts and rotates target the accumulator. */
+  bool     acc_mode;
 
   /*
    * Processor Status Register
@@ -51,18 +144,65 @@ private:
    * ||+---- Unused
    * |+---- Overflow
    * +-- Negative
-   */
-  std::bitset<8> pstat_r;
+   *
+   * With MP6502_LAZY_FLAGS defined, only I, D, B and Unused are kept here.
+   * N, Z, C and V live in the flag_* fields below and are folded back in
+   * by get_status().
+   */
+  uint8_t pstat_r;
+
+#ifdef MP6502_LAZY_FLAGS
+  /* Lazy flags. Each holds a raw result and is decoded when observed. */
+  /* Negative is bit 7 of flag_n. */
+  uint8_t  flag_n;
+  /* Zero is set when flag_z is 0. */
+  uint8_t  flag_z;
+  /* Carry is bit 8 of flag_c (the carry out of an 8-bit result). */
+  uint16_t flag_c;
+  /* Overflow is bit 7 of flag_v. */
+  uint8_t  flag_v;
+#endif
+
+  /* Handler for a single opcode. Runs its addressing mode and operation. */
+  typedef void (*OpHandler)(NES6502 &);
 
   struct Instruction {
-    uint8_t opcode;
-    void (NES6502::*addr_mode)(void) = nullptr;
-    uint8_t (NES6502::*op_exec)(void) = nullptr;
+    uint8_t   opcode;
+    OpHandler exec;
+    uint8_t   cycles;
+  };
+
+  /*
+   * Opcode table, indexed by opcode.
+   * Built at compile time and shared between every instance.
+   */
+  static const std::array<Instruction, 256> instr;
+
+#ifdef MP6502_DISPATCH_BASELINE
+  struct MemberInstruction {
+    void (NES6502::*mode)(void);
+    uint8_t (NES6502::*op)(void);
     uint8_t cycles;
   };
-  std::vector<Instruction> instr;
+  static const std::vector<MemberInstruction> member_instr;
+#endif
 
-  Bus                      bus;
+  /*
+   * Fuses an addressing mode and an operation into one handler.
+   * Both member pointers are template arguments, so the calls are
+   * resolved at compile time and inlined into the handler, which leaves
+   * the table lookup in step() as the only indirect branch.
+   */
+  template <void (NES6502::*Mode)(void), uint8_t (NES6502::*Op)(void)>
+  static void fused(NES6502 &cpu) {
+    (cpu.*Mode)();
+    (cpu.*Op)();
+  }
+
+  /* Bus the CPU is attached to. Owned by the caller, so a batch can lay
+   * its machines' Buses out however it likes.
+   */
+  Bus &bus;
 
 private:
   /* Cycle operations */
@@ -72,6 +212,9 @@ private:
    */
   uint8_t read_pc8();
 
+  /* read_pc8() when code_page is stale or pc is not in plain memory. */
+  uint8_t read_pc8_slow();
+
   /* Fetch the next 2 bytes pointed to by the program counter.
    * Increments the program counter by 2.
    */
@@ -86,9 +229,26 @@ private:
   /* Read a 16-bit value from zero page memory. */
   uint16_t read16_zp(uint16_t addr);
 
+  /* Read the operand of a read instruction.
+   * Adds the page-crossing penalty for indexed addressing modes.
+   */
+  uint8_t fetch();
+
+  /* Read the operand of a read-modify-write instruction (memory or accumulator). */
+  uint8_t fetch_rmw();
+
+  /* Write back the result of a read-modify-write instruction. */
+  void    store_rmw(uint8_t data);
+
   /* Write a byte to memory. */
   void    write(uint16_t addr, uint8_t data);
 
+  /* Push pc and status, set I and jump through `vector`. Shared by NMI and IRQ. */
+  void    interrupt(uint16_t vector);
+
+  /* Make run() return after the current instruction if it left I clear. */
+  void    end_batch();
+
   void    push_stk(uint8_t data);
   uint8_t pop_stk();
 
@@ -747,14 +907,29 @@ private:
   void    set_overflow(bool flag);
   void    set_negative(bool flag);
 
-  uint8_t get_carry();
-  uint8_t get_zero();
-  uint8_t get_interrupt_disable();
-  uint8_t get_decimal_mode();
-  uint8_t get_break();
-  uint8_t get_unused();
-  uint8_t get_overflow();
-  uint8_t get_negative();
+  uint8_t get_carry() const;
+  uint8_t get_zero() const;
+  uint8_t get_interrupt_disable() const;
+  uint8_t get_decimal_mode() const;
+  uint8_t get_break() const;
+  uint8_t get_unused() const;
+  uint8_t get_overflow() const;
+  uint8_t get_negative() const;
 
   void    set_zn(uint8_t val);
+
+  /* Set carry from bit 8 of a 9-bit result. */
+  void    set_carry_from(uint16_t result);
+
+  /* Set overflow from bit 7 of bits. */
+  void    set_overflow_from(uint8_t bits);
+
+  /* Shared by ADC and SBC: acc = acc + data + carry, setting C, V, Z and N. */
+  void    add_with_carry(uint8_t data);
+
+  /* Shared by CMP, CPX and CPY: sets C, Z and N from reg - operand. */
+  void    compare(uint8_t reg);
+
+  /* Take the branch to rel_addr if cond holds, adding the taken/page-cross cycles. */
+  void    branch(bool cond);
 };
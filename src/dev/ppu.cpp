@@ -0,0 +1,881 @@
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <tmmintrin.h>
+#endif
+
+#include "./clock.hpp"
+#include "./mapper.hpp"
+#include "./ppu.hpp"
+#include "../io/log.hpp"
+#include "../io/savestate.hpp"
+
+/* Broadcast a byte to all eight lanes of a ChrRow. */
+constexpr uint64_t BYTE_LANES = 0x0101010101010101ULL;
+
+/* A common 2C02 palette, 0xRRGGBB. */
+// clang-format off
+static constexpr uint32_t NES_RGB[NES_COLORS] = {
+    0x626262, 0x001FB2, 0x2404C8, 0x5200B2, 0x730076, 0x800024, 0x730B00, 0x522800,
+    0x244400, 0x005700, 0x005C00, 0x005324, 0x003C76, 0x000000, 0x000000, 0x000000,
+    0xABABAB, 0x0D57FF, 0x4B30FF, 0x8A13FF, 0xBC08D6, 0xD21269, 0xC72E00, 0x9D5400,
+    0x607B00, 0x209800, 0x00A300, 0x009942, 0x007DB4, 0x000000, 0x000000, 0x000000,
+    0xFFFFFF, 0x53AEFF, 0x9085FF, 0xD365FF, 0xFF57FF, 0xFF5DCF, 0xFF7757, 0xFA9E00,
+    0xBDC700, 0x7AE700, 0x43F611, 0x26EF7E, 0x2CD5F6, 0x4E4E4E, 0x000000, 0x000000,
+    0xFFFFFF, 0xB6E1FF, 0xCED1FF, 0xE9C3FF, 0xFFBCFF, 0xFFBDF4, 0xFFC6C3, 0xFFD59A,
+    0xE9E681, 0xCEF481, 0xB6FB9A, 0xA9FAC3, 0xA9F0F4, 0xB8B8B8, 0x000000, 0x000000,
+};
+// clang-format on
+
+static constexpr std::array<uint32_t, NES_COLORS> make_rgba_table() {
+  std::array<uint32_t, NES_COLORS> table = {};
+  for (size_t i = 0; i < NES_COLORS; i++) {
+    uint32_t r = NES_RGB[i] >> 16;
+    uint32_t g = (NES_RGB[i] >> 8) & 0xFF;
+    uint32_t b = NES_RGB[i] & 0xFF;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    table[i] = r << 24 | g << 16 | b << 8 | 0xFF;
+#else
+    table[i] = r | g << 8 | b << 16 | 0xFF000000;
+#endif
+  }
+  return table;
+}
+
+static constexpr std::array<uint32_t, NES_COLORS> RGBA_TABLE =
+    make_rgba_table();
+
+uint32_t nes_rgba(uint8_t index) { return RGBA_TABLE[index & 0x3F]; }
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/* One colour channel of the palette as four 16-entry shuffle tables. */
+static constexpr std::array<uint8_t, NES_COLORS> channel_table(int shift) {
+  std::array<uint8_t, NES_COLORS> table = {};
+  for (size_t i = 0; i < NES_COLORS; i++) {
+    table[i] = uint8_t(NES_RGB[i] >> shift);
+  }
+  return table;
+}
+
+alignas(16) static constexpr std::array<uint8_t, NES_COLORS> RED_TABLE =
+    channel_table(16);
+alignas(16) static constexpr std::array<uint8_t, NES_COLORS> GREEN_TABLE =
+    channel_table(8);
+alignas(16) static constexpr std::array<uint8_t, NES_COLORS> BLUE_TABLE =
+    channel_table(0);
+
+/* Look 16 indices up in a 64-entry byte table. PSHUFB covers 16 entries
+ * and zeroes any lane whose index has bit 7 set, so look in each quarter
+ * with the indices `quarter` holds for it and OR the results.
+ */
+__attribute__((target("ssse3"))) static inline __m128i
+lookup_channel(const uint8_t *table, const __m128i quarter[4]) {
+  const __m128i *rows = reinterpret_cast<const __m128i *>(table);
+  return _mm_or_si128(
+      _mm_or_si128(_mm_shuffle_epi8(_mm_load_si128(rows), quarter[0]),
+                   _mm_shuffle_epi8(_mm_load_si128(rows + 1), quarter[1])),
+      _mm_or_si128(_mm_shuffle_epi8(_mm_load_si128(rows + 2), quarter[2]),
+                   _mm_shuffle_epi8(_mm_load_si128(rows + 3), quarter[3])));
+}
+
+__attribute__((target("ssse3"))) static void
+indices_to_rgba_ssse3(const uint8_t *indices, uint32_t *rgba, size_t count) {
+  const __m128i alpha = _mm_set1_epi8(char(0xFF));
+  const __m128i bias = _mm_set1_epi8(0x70);
+  for (size_t i = 0; i < count; i += 16) {
+    __m128i index =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(indices + i));
+    /// XOR moves quarter q's entries to 0-15; adding 0x70 with saturation
+    /// keeps their low nibble and pushes every other index to bit 7.
+    __m128i quarter[4];
+    for (int q = 0; q < 4; q++) {
+      quarter[q] = _mm_adds_epu8(
+          _mm_xor_si128(index, _mm_set1_epi8(char(q * 16))), bias);
+    }
+    __m128i r = lookup_channel(RED_TABLE.data(), quarter);
+    __m128i g = lookup_channel(GREEN_TABLE.data(), quarter);
+    __m128i b = lookup_channel(BLUE_TABLE.data(), quarter);
+    /// Interleave the channels into R, G, B, A byte order.
+    __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+    __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+    __m128i ba_lo = _mm_unpacklo_epi8(b, alpha);
+    __m128i ba_hi = _mm_unpackhi_epi8(b, alpha);
+    __m128i *out = reinterpret_cast<__m128i *>(rgba + i);
+    _mm_storeu_si128(out, _mm_unpacklo_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+  }
+}
+#endif
+
+void indices_to_rgba(const uint8_t *indices, uint32_t *rgba, size_t count) {
+#if defined(__x86_64__) && defined(__GNUC__)
+  static const bool ssse3 = __builtin_cpu_supports("ssse3");
+  if (ssse3) {
+    indices_to_rgba_ssse3(indices, rgba, count);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count; i++) {
+    rgba[i] = RGBA_TABLE[indices[i] & 0x3F];
+  }
+}
+
+static uint8_t palette_index(uint16_t addr) {
+  uint8_t index = addr & 0x1F;
+  /// Sprite palette entry 0 of each set mirrors the background's.
+  return (index & 0x13) == 0x10 ? index & 0x0F : index;
+}
+
+PPU::PPU() {
+  MP6502_LOG(LogLevel::Debug, "PPU initialized");
+  _ctrl = 0;
+  _mask = 0;
+  _status = 0;
+  _oam_addr = 0;
+  _latch = 0;
+  _read_buffer = 0;
+  _v = 0;
+  _t = 0;
+  _fine_x = 0;
+  _w = false;
+  _nmi = false;
+  _odd_frame = false;
+  _line = 0;
+  _dot = 0;
+  _clock = 0;
+  _frames = 0;
+  _mode = RenderMode::Scanline;
+  _render_interval = 1;
+  _skip = false;
+  _bg_lo = 0;
+  _bg_hi = 0;
+  _at_lo = 0;
+  _at_hi = 0;
+  _next_nt = 0;
+  _next_at = 0;
+  _next_lo = 0;
+  _next_hi = 0;
+  _sprite_count = 0;
+  _sprite_zero = false;
+  _hit_dot = 0;
+  _vram.fill(0);
+  _vram_dirty.fill(0);
+  _palette.fill(0);
+  _oam.fill(0);
+  for (Picture &picture : _pictures) {
+    picture.fill(0);
+  }
+  _back = 0;
+  _front_frame = 0;
+  _rgba_current = false;
+  _mapper = nullptr;
+}
+
+void PPU::attach(Mapper *mapper) { _mapper = mapper; }
+
+void PPU::set_mode(RenderMode mode) {
+  _mode = mode;
+  predict_sprite_zero();
+}
+
+void PPU::set_render_interval(uint32_t frames) { _render_interval = frames; }
+
+void PPU::mapper_changed() { predict_sprite_zero(); }
+
+uint8_t PPU::read_chr(uint16_t addr) const {
+  return _mapper != nullptr ? _mapper->chr_read(addr) : 0;
+}
+
+ChrRow PPU::read_chr_row(uint16_t addr) const {
+  return _mapper != nullptr ? _mapper->chr_row(addr) : 0;
+}
+
+uint16_t PPU::nametable_index(uint16_t addr) const {
+  uint16_t  table = (addr >> 10) & 0x03;
+  Mirroring mirroring =
+      _mapper != nullptr ? _mapper->get_mirroring() : Mirroring::Horizontal;
+  switch (mirroring) {
+  case Mirroring::Horizontal:
+    table >>= 1;
+    break;
+  case Mirroring::Vertical:
+    table &= 1;
+    break;
+  case Mirroring::SingleLower:
+    table = 0;
+    break;
+  case Mirroring::SingleUpper:
+    table = 1;
+    break;
+  case Mirroring::FourScreen:
+    break;
+  }
+  return table * 0x400 + (addr & 0x03FF);
+}
+
+uint8_t PPU::read_vram(uint16_t addr) const {
+  addr &= 0x3FFF;
+  if (addr < 0x2000) {
+    return read_chr(addr);
+  } else if (addr < 0x3F00) {
+    return _vram[nametable_index(addr)];
+  }
+  return _palette[palette_index(addr)];
+}
+
+void PPU::write_vram(uint16_t addr, uint8_t data) {
+  addr &= 0x3FFF;
+  if (addr < 0x2000) {
+    if (_mapper != nullptr) {
+      _mapper->chr_write(addr, data);
+    }
+  } else if (addr < 0x3F00) {
+    uint16_t index = nametable_index(addr);
+    _vram[index] = data;
+    _vram_dirty[index >> 8] = 1;
+  } else {
+    _palette[palette_index(addr)] = data & 0x3F;
+  }
+}
+
+uint8_t PPU::read_register(uint8_t reg) {
+  switch (reg & 0x07) {
+  case 2:
+    _latch = (_status & 0xE0) | (_latch & 0x1F);
+    _status &= ~STATUS_VBLANK;
+    _w = false;
+    break;
+  case 4:
+    _latch = _oam[_oam_addr];
+    break;
+  case 7: {
+    uint16_t addr = _v & 0x3FFF;
+    if (addr >= 0x3F00) {
+      /// Palette reads bypass the buffer, which gets the nametable byte
+      /// underneath instead.
+      _latch = (_latch & 0xC0) | read_vram(addr);
+      _read_buffer = read_vram(addr - 0x1000);
+    } else {
+      _latch = _read_buffer;
+      _read_buffer = read_vram(addr);
+    }
+    _v = (_v + (_ctrl & CTRL_INCREMENT_32 ? 32 : 1)) & 0x7FFF;
+    break;
+  }
+  }
+  return _latch;
+}
+
+void PPU::write_register(uint8_t reg, uint8_t data) {
+  _latch = data;
+  switch (reg & 0x07) {
+  case 0:
+    /// Enabling NMI during vblank raises one straight away.
+    if (!(_ctrl & CTRL_NMI) && (data & CTRL_NMI) && (_status & STATUS_VBLANK)) {
+      _nmi = true;
+    }
+    _ctrl = data;
+    _t = (_t & 0xF3FF) | (data & 0x03) << 10;
+    break;
+  case 1:
+    _mask = data;
+    break;
+  case 3:
+    _oam_addr = data;
+    break;
+  case 4:
+    _oam[_oam_addr++] = data;
+    break;
+  case 5:
+    if (!_w) {
+      _t = (_t & ~0x001F) | data >> 3;
+      _fine_x = data & 0x07;
+    } else {
+      _t = (_t & ~0x73E0) | (data & 0x07) << 12 | (data & 0xF8) << 2;
+    }
+    _w = !_w;
+    break;
+  case 6:
+    if (!_w) {
+      _t = (_t & 0x00FF) | (data & 0x3F) << 8;
+    } else {
+      _t = (_t & 0xFF00) | data;
+      _v = _t;
+    }
+    _w = !_w;
+    break;
+  case 7:
+    write_vram(_v, data);
+    _v = (_v + (_ctrl & CTRL_INCREMENT_32 ? 32 : 1)) & 0x7FFF;
+    break;
+  }
+  /// Any of scroll, masks, pattern tables or VRAM may move the hit.
+  predict_sprite_zero();
+}
+
+void PPU::write_oam_dma(const uint8_t *page) {
+  for (uint16_t i = 0; i < OAM_SIZE; i++) {
+    _oam[(_oam_addr + i) & 0xFF] = page[i];
+  }
+  predict_sprite_zero();
+}
+
+bool PPU::take_nmi() {
+  bool nmi = _nmi;
+  _nmi = false;
+  return nmi;
+}
+
+void PPU::increment_x() {
+  if ((_v & 0x001F) == 31) {
+    _v = (_v & ~0x001F) ^ 0x0400;
+  } else {
+    _v++;
+  }
+}
+
+void PPU::increment_y() {
+  if ((_v & 0x7000) != 0x7000) {
+    _v += 0x1000;
+    return;
+  }
+  _v &= ~0x7000;
+  uint16_t y = (_v & 0x03E0) >> 5;
+  if (y == 29) {
+    y = 0;
+    _v ^= 0x0800;
+  } else if (y == 31) {
+    y = 0;
+  } else {
+    y++;
+  }
+  _v = (_v & ~0x03E0) | y << 5;
+}
+
+void PPU::copy_x() { _v = (_v & ~0x041F) | (_t & 0x041F); }
+void PPU::copy_y() { _v = (_v & ~0x7BE0) | (_t & 0x7BE0); }
+
+void PPU::catch_up(uint64_t now) {
+  uint64_t target = now * PPU_DOTS_PER_CPU_CYCLE;
+  while (_clock < target) {
+    /// Odd frames drop the pre-render line's last dot while rendering.
+    if (_dot == PPU_DOTS_PER_LINE ||
+        (_line == PPU_PRERENDER_LINE && _dot == 340 && _odd_frame &&
+         rendering())) {
+      next_line();
+      continue;
+    }
+    uint16_t event = next_event_dot();
+    if (event > _dot) {
+      uint64_t span = std::min<uint64_t>(event - _dot, target - _clock);
+      _dot += span;
+      _clock += span;
+      continue;
+    }
+    run_dot();
+    _dot++;
+    _clock++;
+  }
+}
+
+void PPU::next_line() {
+  _dot = 0;
+  if (++_line == PPU_LINES_PER_FRAME) {
+    _line = 0;
+    _odd_frame = !_odd_frame;
+    /// The frame starting now becomes number _frames + 1 at its vblank.
+    _skip = _render_interval == 0 || (_frames + 1) % _render_interval != 0;
+  }
+  predict_sprite_zero();
+}
+
+uint16_t PPU::next_event_dot() const {
+  static constexpr uint16_t VISIBLE[] = {256, 257, 260, 328, 336};
+  static constexpr uint16_t PRERENDER[] = {1,   256, 257, 260,
+                                           280, 328, 336, 340};
+  bool visible = _line < SCREEN_HEIGHT;
+  if (visible || _line == PPU_PRERENDER_LINE) {
+    if (_mode == RenderMode::Dot && (visible || rendering())) {
+      return _dot;
+    }
+    if (!rendering()) {
+      if (visible) {
+        return _dot <= 256 ? 256 : PPU_DOTS_PER_LINE;
+      }
+      return _dot <= 1 ? 1 : PPU_DOTS_PER_LINE;
+    }
+    if (_hit_dot != 0 && _hit_dot >= _dot) {
+      return _hit_dot;
+    }
+    const uint16_t *first = visible ? std::begin(VISIBLE) : std::begin(PRERENDER);
+    const uint16_t *last = visible ? std::end(VISIBLE) : std::end(PRERENDER);
+    for (const uint16_t *dot = first; dot != last; dot++) {
+      if (*dot >= _dot) {
+        return *dot;
+      }
+    }
+  } else if (_line == PPU_VBLANK_LINE && _dot <= 1) {
+    return 1;
+  }
+  return PPU_DOTS_PER_LINE;
+}
+
+void PPU::run_dot() {
+  if (_line == PPU_VBLANK_LINE) {
+    if (_dot == 1) {
+      _status |= STATUS_VBLANK;
+      _frames++;
+      /// The finished picture goes to the front; a skipped frame leaves
+      /// the last composed one there.
+      if (!_skip) {
+        _back ^= 1;
+        _front_frame = _frames;
+        _rgba_current = false;
+      }
+      if (_ctrl & CTRL_NMI) {
+        _nmi = true;
+      }
+    }
+    return;
+  }
+  bool visible = _line < SCREEN_HEIGHT;
+  if (_line == PPU_PRERENDER_LINE && _dot == 1) {
+    _status &= ~(STATUS_VBLANK | STATUS_SPRITE_ZERO | STATUS_OVERFLOW);
+  }
+  if (_mode == RenderMode::Dot) {
+    run_pipeline_dot();
+    return;
+  }
+  if (!rendering()) {
+    if (visible && _dot == 256 && !_skip) {
+      for (uint16_t x = 0; x < SCREEN_WIDTH; x++) {
+        output(x, 0, 0, false, false);
+      }
+    }
+    return;
+  }
+  if (_hit_dot != 0 && _dot == _hit_dot) {
+    _status |= STATUS_SPRITE_ZERO;
+  }
+  switch (_dot) {
+  case 256:
+    if (visible && !_skip) {
+      render_line();
+    }
+    increment_y();
+    break;
+  case 257:
+    copy_x();
+    evaluate_sprites();
+    break;
+  case 260:
+    if (_mapper != nullptr) {
+      _mapper->clock_scanline();
+    }
+    break;
+  case 280:
+    if (_line == PPU_PRERENDER_LINE) {
+      copy_y();
+    }
+    break;
+  case 328:
+  case 336:
+    increment_x();
+    break;
+  }
+}
+
+void PPU::run_pipeline_dot() {
+  bool visible = _line < SCREEN_HEIGHT;
+  if (rendering()) {
+    if ((_dot >= 2 && _dot <= 257) || (_dot >= 321 && _dot <= 337)) {
+      _bg_lo <<= 1;
+      _bg_hi <<= 1;
+      _at_lo <<= 1;
+      _at_hi <<= 1;
+      uint16_t base = _ctrl & CTRL_BG_TABLE ? 0x1000 : 0x0000;
+      switch ((_dot - 1) % 8) {
+      case 0:
+        _bg_lo = (_bg_lo & 0xFF00) | _next_lo;
+        _bg_hi = (_bg_hi & 0xFF00) | _next_hi;
+        _at_lo = (_at_lo & 0xFF00) | (_next_at & 1 ? 0xFF : 0x00);
+        _at_hi = (_at_hi & 0xFF00) | (_next_at & 2 ? 0xFF : 0x00);
+        _next_nt = read_vram(0x2000 | (_v & 0x0FFF));
+        break;
+      case 2: {
+        uint8_t at = read_vram(0x23C0 | (_v & 0x0C00) | ((_v >> 4) & 0x38) |
+                               ((_v >> 2) & 0x07));
+        _next_at = (at >> (((_v >> 4) & 0x04) | (_v & 0x02))) & 0x03;
+        break;
+      }
+      case 4:
+        _next_lo = read_chr(base + _next_nt * 16 + ((_v >> 12) & 0x07));
+        break;
+      case 6:
+        _next_hi = read_chr(base + _next_nt * 16 + ((_v >> 12) & 0x07) + 8);
+        break;
+      case 7:
+        increment_x();
+        break;
+      }
+    }
+    if (_dot == 256) {
+      increment_y();
+    } else if (_dot == 257) {
+      copy_x();
+      evaluate_sprites();
+    } else if (_dot == 260 && _mapper != nullptr) {
+      _mapper->clock_scanline();
+    } else if (_line == PPU_PRERENDER_LINE && _dot >= 280 && _dot <= 304) {
+      copy_y();
+    }
+  }
+  /// A skipped frame still needs the pixels sprite 0 covers.
+  if (visible && _dot >= 1 && _dot <= SCREEN_WIDTH &&
+      (!_skip ||
+       (_sprite_zero && uint16_t(_dot - 1 - _sprites[0].x) < 8))) {
+    render_pixel(_dot - 1);
+  }
+}
+
+void PPU::evaluate_sprites() {
+  _sprite_count = 0;
+  _sprite_zero = false;
+  if (_line >= SCREEN_HEIGHT) {
+    return;
+  }
+  uint8_t height = _ctrl & CTRL_SPRITE_8X16 ? 16 : 8;
+  for (uint16_t i = 0; i < OAM_SIZE; i += 4) {
+    uint16_t row = _line - _oam[i];
+    if (row >= height) {
+      continue;
+    }
+    if (_sprite_count == SPRITES_PER_LINE) {
+      _status |= STATUS_OVERFLOW;
+      break;
+    }
+    uint8_t  tile = _oam[i + 1];
+    uint8_t  attr = _oam[i + 2];
+    uint16_t table;
+    if (attr & 0x80) {
+      row = height - 1 - row;
+    }
+    if (height == 16) {
+      table = tile & 0x01 ? 0x1000 : 0x0000;
+      tile &= 0xFE;
+      if (row >= 8) {
+        tile++;
+        row -= 8;
+      }
+    } else {
+      table = _ctrl & CTRL_SPRITE_TABLE ? 0x1000 : 0x0000;
+    }
+    ChrRow pixels = read_chr_row(table + tile * 16 + row);
+    /// Byte i is pixel i, so reversing the bytes mirrors the row.
+    if (attr & 0x40) {
+      pixels = __builtin_bswap64(pixels);
+    }
+    SpriteRow &sprite = _sprites[_sprite_count++];
+    sprite.x = _oam[i + 3];
+    sprite.attr = attr;
+    std::memcpy(sprite.pixels, &pixels, 8);
+    if (i == 0) {
+      _sprite_zero = true;
+    }
+  }
+}
+
+uint16_t PPU::line_start() const {
+  /// At dot 256 v points two tiles past the line's first: the first two
+  /// tiles of each line are prefetched at dots 321-336 of the one before.
+  uint16_t v = _v;
+  for (int i = 0; i < 2; i++) {
+    v = (v & 0x001F) == 0 ? (v | 0x001F) ^ 0x0400 : v - 1;
+  }
+  return v;
+}
+
+ChrRow PPU::fetch_bg_tile(uint16_t v) const {
+  uint16_t base = _ctrl & CTRL_BG_TABLE ? 0x1000 : 0x0000;
+  uint8_t  nt = read_vram(0x2000 | (v & 0x0FFF));
+  uint8_t  at = read_vram(0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) |
+                          ((v >> 2) & 0x07));
+  uint8_t  palette = (at >> (((v >> 4) & 0x04) | (v & 0x02))) & 0x03;
+  /// Pre-decoded pixels: one lookup per tile, the palette ORed into all
+  /// eight at once.
+  return read_chr_row(base + nt * 16 + ((_v >> 12) & 0x07)) |
+         palette * 4 * BYTE_LANES;
+}
+
+static uint16_t next_tile(uint16_t v) {
+  return (v & 0x001F) == 31 ? (v & ~0x001F) ^ 0x0400 : v + 1;
+}
+
+void PPU::render_line() {
+  /// 33 tiles cover 256 pixels at any fine X.
+  constexpr size_t TILES = 33;
+  uint8_t          bg[TILES * 8];
+  if (_mask & MASK_BG) {
+    uint16_t v = line_start();
+    for (size_t i = 0; i < TILES; i++) {
+      ChrRow row = fetch_bg_tile(v);
+      std::memcpy(bg + i * 8, &row, 8);
+      v = next_tile(v);
+    }
+  } else {
+    std::memset(bg, 0, sizeof(bg));
+  }
+
+  uint8_t sprites[SCREEN_WIDTH] = {}; // 0x10 | palette << 2 | pattern
+  uint8_t behind[SCREEN_WIDTH] = {};
+  if (_mask & MASK_SPRITES) {
+    /// Draw back to front so the lowest OAM index ends up on top.
+    for (int i = _sprite_count - 1; i >= 0; i--) {
+      const SpriteRow &sprite = _sprites[i];
+      for (uint16_t col = 0; col < 8 && sprite.x + col < SCREEN_WIDTH; col++) {
+        uint8_t pattern = sprite.pixels[col];
+        if (pattern != 0) {
+          uint16_t x = sprite.x + col;
+          sprites[x] = 0x10 | (sprite.attr & 0x03) << 2 | pattern;
+          behind[x] = sprite.attr & 0x20;
+        }
+      }
+    }
+  }
+
+  /// Sprite 0 hits were already flagged at their own dot.
+  for (uint16_t x = 0; x < SCREEN_WIDTH; x++) {
+    output(x, bg[x + _fine_x], sprites[x], behind[x], false);
+  }
+}
+
+void PPU::predict_sprite_zero() {
+  _hit_dot = 0;
+  if (_mode != RenderMode::Scanline || _line >= SCREEN_HEIGHT ||
+      _dot > SCREEN_WIDTH || !_sprite_zero ||
+      (_status & STATUS_SPRITE_ZERO) || !(_mask & MASK_BG) ||
+      !(_mask & MASK_SPRITES)) {
+    return;
+  }
+  /// Only the (at most two) background tiles under sprite 0 can hit.
+  const SpriteRow &sprite = _sprites[0];
+  uint16_t         first = (sprite.x + _fine_x) / 8;
+  uint16_t         v = line_start();
+  uint16_t         coarse = (v & 0x001F) + first;
+  v = (v & ~0x001F) | (coarse & 0x001F);
+  if (coarse >= 32) {
+    v ^= 0x0400;
+  }
+  uint8_t bg[16];
+  ChrRow  row = fetch_bg_tile(v);
+  std::memcpy(bg, &row, 8);
+  row = fetch_bg_tile(next_tile(v));
+  std::memcpy(bg + 8, &row, 8);
+  bool clip = !(_mask & MASK_BG_LEFT) || !(_mask & MASK_SPRITES_LEFT);
+  /// Pixel 255 never hits, and x + 1 is the dot that draws pixel x, so
+  /// dots already run cannot hit any more.
+  for (uint16_t col = 0; col < 8 && sprite.x + col < 255; col++) {
+    uint16_t x = sprite.x + col;
+    if (x + 1 < _dot || (x < 8 && clip)) {
+      continue;
+    }
+    if (sprite.pixels[col] != 0 && (bg[x + _fine_x - first * 8] & 0x03)) {
+      _hit_dot = x + 1;
+      return;
+    }
+  }
+}
+
+void PPU::render_pixel(uint16_t x) {
+  uint8_t bg = 0;
+  if (_mask & MASK_BG) {
+    uint16_t bit = 0x8000 >> _fine_x;
+    bg = (_bg_lo & bit ? 1 : 0) | (_bg_hi & bit ? 2 : 0) |
+         (_at_lo & bit ? 4 : 0) | (_at_hi & bit ? 8 : 0);
+  }
+  if (_mask & MASK_SPRITES) {
+    for (uint8_t i = 0; i < _sprite_count; i++) {
+      const SpriteRow &sprite = _sprites[i];
+      uint16_t         col = x - sprite.x;
+      if (col < 8 && sprite.pixels[col] != 0) {
+        output(x, bg, 0x10 | (sprite.attr & 0x03) << 2 | sprite.pixels[col],
+               sprite.attr & 0x20, i == 0 && _sprite_zero);
+        return;
+      }
+    }
+  }
+  output(x, bg, 0, false, false);
+}
+
+void PPU::output(uint16_t x, uint8_t bg, uint8_t sprite, bool behind,
+                 bool sprite_zero) {
+  if (x < 8 && !(_mask & MASK_BG_LEFT)) {
+    bg = 0;
+  }
+  if (x < 8 && !(_mask & MASK_SPRITES_LEFT)) {
+    sprite = 0;
+  }
+  bool bg_opaque = bg & 0x03;
+  bool sprite_opaque = sprite & 0x03;
+  if (sprite_zero && sprite_opaque && bg_opaque && x != 255) {
+    _status |= STATUS_SPRITE_ZERO;
+  }
+  if (_skip) {
+    return;
+  }
+  uint8_t index = 0;
+  if (sprite_opaque && (!bg_opaque || !behind)) {
+    index = sprite;
+  } else if (bg_opaque) {
+    index = bg;
+  }
+  _pictures[_back][_line * SCREEN_WIDTH + x] =
+      _palette[index] & (_mask & MASK_GRAYSCALE ? 0x30 : 0x3F);
+}
+
+uint64_t PPU::cycles_until(uint16_t line, uint16_t dot) const {
+  uint64_t here = _line * PPU_DOTS_PER_LINE + _dot;
+  uint64_t there = line * PPU_DOTS_PER_LINE + dot;
+  uint64_t dots;
+  if (there >= here) {
+    dots = there - here;
+  } else {
+    uint64_t frame = PPU_LINES_PER_FRAME * PPU_DOTS_PER_LINE -
+                     (_odd_frame && rendering() ? 1 : 0);
+    dots = frame - here + there;
+  }
+  /// The dot runs once the clock passes it; round up to a whole CPU cycle.
+  return (_clock + dots + PPU_DOTS_PER_CPU_CYCLE) / PPU_DOTS_PER_CPU_CYCLE;
+}
+
+uint64_t PPU::next_event() const {
+  /// An edge raised by a $2000 write is due straight away.
+  if (_nmi) {
+    return 0;
+  }
+  uint64_t event = NO_EVENT;
+  if (_ctrl & CTRL_NMI) {
+    event = cycles_until(PPU_VBLANK_LINE, 1);
+  }
+  uint32_t scanlines =
+      _mapper != nullptr && rendering() ? _mapper->scanlines_until_irq()
+                                        : NO_SCANLINE_IRQ;
+  if (scanlines == NO_SCANLINE_IRQ) {
+    return event;
+  }
+  /// Walk forward over the lines that clock the cartridge (dot 260 of
+  /// each rendered line) until the one that raises IRQ.
+  uint16_t line = _line;
+  uint16_t dot = _dot;
+  bool     odd = _odd_frame;
+  uint64_t dots = 0;
+  for (;;) {
+    if ((line < SCREEN_HEIGHT || line == PPU_PRERENDER_LINE) && dot <= 260 &&
+        --scanlines == 0) {
+      dots += 260 - dot;
+      break;
+    }
+    uint16_t length = line == PPU_PRERENDER_LINE && odd ? 340 : 341;
+    dots += length - dot;
+    dot = 0;
+    if (++line == PPU_LINES_PER_FRAME) {
+      line = 0;
+      odd = !odd;
+    }
+  }
+  uint64_t irq =
+      (_clock + dots + PPU_DOTS_PER_CPU_CYCLE) / PPU_DOTS_PER_CPU_CYCLE;
+  return std::min(event, irq);
+}
+
+void PPU::save(StateWriter &writer) const {
+  writer.put(_ctrl);
+  writer.put(_mask);
+  writer.put(_status);
+  writer.put(_oam_addr);
+  writer.put(_latch);
+  writer.put(_read_buffer);
+  writer.put(_v);
+  writer.put(_t);
+  writer.put(_fine_x);
+  writer.put<uint8_t>(_w);
+  writer.put<uint8_t>(_nmi);
+  writer.put<uint8_t>(_odd_frame);
+  writer.put(_line);
+  writer.put(_dot);
+  writer.put(_clock);
+  writer.put(_frames);
+  writer.put<uint8_t>(_skip);
+  writer.put(_back);
+  writer.put(_front_frame);
+  writer.put(_bg_lo);
+  writer.put(_bg_hi);
+  writer.put(_at_lo);
+  writer.put(_at_hi);
+  writer.put(_next_nt);
+  writer.put(_next_at);
+  writer.put(_next_lo);
+  writer.put(_next_hi);
+  writer.write(_sprites.data(), sizeof(_sprites));
+  writer.put(_sprite_count);
+  writer.put<uint8_t>(_sprite_zero);
+  writer.write_pages(_vram.data(), _vram_dirty.data(), _vram_dirty.size());
+  writer.write(_palette.data(), _palette.size());
+  writer.write(_oam.data(), _oam.size());
+}
+
+void PPU::load(StateReader &reader) {
+  _ctrl = reader.get<uint8_t>();
+  _mask = reader.get<uint8_t>();
+  _status = reader.get<uint8_t>();
+  _oam_addr = reader.get<uint8_t>();
+  _latch = reader.get<uint8_t>();
+  _read_buffer = reader.get<uint8_t>();
+  _v = reader.get<uint16_t>();
+  _t = reader.get<uint16_t>();
+  _fine_x = reader.get<uint8_t>();
+  _w = reader.get<uint8_t>() != 0;
+  _nmi = reader.get<uint8_t>() != 0;
+  _odd_frame = reader.get<uint8_t>() != 0;
+  _line = reader.get<uint16_t>();
+  _dot = reader.get<uint16_t>();
+  _clock = reader.get<uint64_t>();
+  _frames = reader.get<uint64_t>();
+  _skip = reader.get<uint8_t>() != 0;
+  _back = reader.get<uint8_t>() & 1;
+  _front_frame = reader.get<uint64_t>();
+  _bg_lo = reader.get<uint16_t>();
+  _bg_hi = reader.get<uint16_t>();
+  _at_lo = reader.get<uint16_t>();
+  _at_hi = reader.get<uint16_t>();
+  _next_nt = reader.get<uint8_t>();
+  _next_at = reader.get<uint8_t>();
+  _next_lo = reader.get<uint8_t>();
+  _next_hi = reader.get<uint8_t>();
+  reader.read(_sprites.data(), sizeof(_sprites));
+  _sprite_count = std::min<uint8_t>(reader.get<uint8_t>(), SPRITES_PER_LINE);
+  _sprite_zero = reader.get<uint8_t>() != 0;
+  reader.read_pages(_vram.data(), _vram_dirty.data(), _vram_dirty.size());
+  reader.read(_palette.data(), _palette.size());
+  reader.read(_oam.data(), _oam.size());
+  if (_line >= PPU_LINES_PER_FRAME || _dot > PPU_DOTS_PER_LINE) {
+    throw std::runtime_error("Save state has an invalid PPU position");
+  }
+  _rgba_current = false;
+  predict_sprite_zero();
+}
+
+const uint32_t *PPU::get_frame_rgba() {
+  if (_rgba == nullptr) {
+    _rgba = std::make_unique<RgbaPicture>();
+  }
+  if (!_rgba_current) {
+    indices_to_rgba(get_frame(), _rgba->pixels.data(), SCREEN_PIXELS);
+    _rgba_current = true;
+  }
+  return _rgba->pixels.data();
+}
+
+void PPU::mark_clean() { _vram_dirty.fill(0); }
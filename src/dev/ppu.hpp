@@ -0,0 +1,271 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "../io/rom.hpp"
+
+class Mapper;
+class StateReader;
+class StateWriter;
+
+constexpr uint16_t PPU_DOTS_PER_LINE = 341;
+constexpr uint16_t PPU_LINES_PER_FRAME = 262;
+constexpr uint16_t PPU_VBLANK_LINE = 241; // Line whose dot 1 sets the vblank flag
+constexpr uint16_t PPU_PRERENDER_LINE = 261;
+constexpr uint16_t PPU_DOTS_PER_CPU_CYCLE = 3;
+constexpr uint16_t SCREEN_WIDTH = 256;
+constexpr uint16_t SCREEN_HEIGHT = 240;
+constexpr size_t   SCREEN_PIXELS = size_t(SCREEN_WIDTH) * SCREEN_HEIGHT;
+constexpr uint16_t VRAM_SIZE = 0x1000; // CIRAM, sized for four-screen boards
+constexpr uint16_t PALETTE_SIZE = 32;
+constexpr uint16_t OAM_SIZE = 256;
+constexpr uint8_t  SPRITES_PER_LINE = 8;
+constexpr uint8_t  NES_COLORS = 64;
+
+/* PPUCTRL ($2000) bits. */
+constexpr uint8_t  CTRL_INCREMENT_32 = 1 << 2;
+constexpr uint8_t  CTRL_SPRITE_TABLE = 1 << 3;
+constexpr uint8_t  CTRL_BG_TABLE = 1 << 4;
+constexpr uint8_t  CTRL_SPRITE_8X16 = 1 << 5;
+constexpr uint8_t  CTRL_NMI = 1 << 7;
+
+/* PPUMASK ($2001) bits. */
+constexpr uint8_t  MASK_GRAYSCALE = 1 << 0;
+constexpr uint8_t  MASK_BG_LEFT = 1 << 1;
+constexpr uint8_t  MASK_SPRITES_LEFT = 1 << 2;
+constexpr uint8_t  MASK_BG = 1 << 3;
+constexpr uint8_t  MASK_SPRITES = 1 << 4;
+
+/* PPUSTATUS ($2002) bits. */
+constexpr uint8_t  STATUS_OVERFLOW = 1 << 5;
+constexpr uint8_t  STATUS_SPRITE_ZERO = 1 << 6;
+constexpr uint8_t  STATUS_VBLANK = 1 << 7;
+
+enum class RenderMode {
+  /* Render each visible line in one go when the PPU reaches its dot 256,
+   * from the mapper's pre-decoded tile rows. Register writes take effect
+   * from the next line, which is all that split-screen scrolling done in
+   * hblank needs. Fastest.
+   */
+  Scanline,
+  /* Run the background fetch pipeline and compose one pixel per dot, so
+   * writes in the middle of a line (raster effects) land on the right
+   * pixel.
+   */
+  Dot,
+};
+
+/* RGBA pixel for NES palette index `index` (0-63): bytes R, G, B, 255 in
+ * memory order on any host.
+ */
+uint32_t nes_rgba(uint8_t index);
+
+/* Convert `count` palette indices (0-63) to RGBA pixels through a 64-entry
+ * table, 16 at a time with SSSE3 byte shuffles where the CPU has them.
+ * `count` must be a multiple of 16.
+ */
+void     indices_to_rgba(const uint8_t *indices, uint32_t *rgba, size_t count);
+
+/*
+ * Picture Processing Unit (2C02, NTSC).
+ *
+ * Simulated lazily like the APU: catch_up() runs it forward to a CPU
+ * timestamp at three dots per cycle, and next_event() reports when it will
+ * next interrupt the CPU (vblank NMI, or the scanline that makes the
+ * cartridge raise IRQ) so the scheduler can stop there. Between those
+ * points only events that have a visible effect are simulated; a span of
+ * dots with nothing in it is skipped in one step.
+ *
+ * The picture is 256x240 NES palette indices (0-63), double-buffered and
+ * exported without copying (get_frame()), with an RGBA view converted on
+ * demand (get_frame_rgba()). Sprites for a line are evaluated at dot 257
+ * of the line before, in both render modes. In Scanline mode the dot of
+ * a sprite 0 hit is predicted as each line starts (and again after any
+ * write that could move it) and the flag is raised at exactly that dot,
+ * so a $2002 polling loop sees it on time without the line being drawn
+ * dot by dot. Sprite overflow is the documented behaviour, not the
+ * hardware's buggy one, and $2007 accesses during rendering do not glitch
+ * v.
+ */
+class PPU {
+private:
+  typedef std::array<uint8_t, SCREEN_PIXELS> Picture;
+
+  /* The front picture converted to RGBA, allocated on first request. */
+  struct alignas(64) RgbaPicture {
+    std::array<uint32_t, SCREEN_PIXELS> pixels;
+  };
+
+  /* One sprite selected for the next line, its row already decoded. */
+  struct SpriteRow {
+    uint8_t x;
+    uint8_t attr; // OAM byte 2: palette, priority, flips
+    uint8_t pixels[8]; // 2-bit pattern values, left to right
+  };
+
+  uint8_t                              _ctrl;
+  uint8_t                              _mask;
+  uint8_t                              _status;
+  uint8_t                              _oam_addr;
+  uint8_t                              _latch; // Last value on the register bus (open bus)
+  uint8_t                              _read_buffer; // $2007 read buffer
+  uint16_t                             _v; // Current VRAM address (loopy v)
+  uint16_t                             _t; // Temporary VRAM address (loopy t)
+  uint8_t                              _fine_x;
+  bool                                 _w; // $2005/$2006 write toggle
+  bool                                 _nmi; // NMI edge not yet taken by the CPU
+  bool                                 _odd_frame;
+
+  uint16_t                             _line;
+  uint16_t                             _dot; // Next dot to run on _line
+  uint64_t                             _clock; // Dots run since power-on
+  uint64_t                             _frames; // Frames completed (vblanks entered)
+  RenderMode                           _mode;
+  uint32_t                             _render_interval; // Compose one frame in this many (0: none)
+  bool                                 _skip; // The current frame is not being composed
+
+  /* Background pipeline (Dot mode). */
+  uint16_t                             _bg_lo; // Pattern shifters
+  uint16_t                             _bg_hi;
+  uint16_t                             _at_lo; // Attribute shifters
+  uint16_t                             _at_hi;
+  uint8_t                              _next_nt; // Latches for the tile being fetched
+  uint8_t                              _next_at;
+  uint8_t                              _next_lo;
+  uint8_t                              _next_hi;
+
+  std::array<SpriteRow, SPRITES_PER_LINE> _sprites; // Sprites on the current line
+  uint8_t                              _sprite_count;
+  bool                                 _sprite_zero; // _sprites[0] is OAM sprite 0
+  uint16_t                             _hit_dot; // Scanline mode: dot of this line's sprite 0 hit, or 0
+
+  std::array<uint8_t, VRAM_SIZE>       _vram; // Nametables
+  std::array<uint8_t, VRAM_SIZE / 0x100> _vram_dirty; // Per 256-byte page
+  std::array<uint8_t, PALETTE_SIZE>    _palette;
+  std::array<uint8_t, OAM_SIZE>        _oam;
+  alignas(64) std::array<Picture, 2>   _pictures; // Front (finished) and back (being composed)
+  uint8_t                              _back; // _pictures index being composed
+  uint64_t                             _front_frame; // Frame number of the front picture
+  std::unique_ptr<RgbaPicture>         _rgba;
+  bool                                 _rgba_current; // _rgba holds the front picture
+
+  Mapper                              *_mapper; // Supplies CHR, mirroring and scanline IRQs
+
+  bool     rendering() const { return _mask & (MASK_BG | MASK_SPRITES); }
+
+  uint8_t  read_vram(uint16_t addr) const;
+  void     write_vram(uint16_t addr, uint8_t data);
+  uint16_t nametable_index(uint16_t addr) const;
+  uint8_t  read_chr(uint16_t addr) const;
+  ChrRow   read_chr_row(uint16_t addr) const;
+
+  /* Loopy scroll register updates. */
+  void     increment_x();
+  void     increment_y();
+  void     copy_x();
+  void     copy_y();
+
+  /* First dot at or after _dot on this line that does anything. */
+  uint16_t next_event_dot() const;
+  void     run_dot();
+  void     run_pipeline_dot();
+  void     next_line();
+
+  void     evaluate_sprites();
+
+  /* v of the current line's first background tile (at dot 256), and the
+   * palette-tagged pixels of the tile at `v`.
+   */
+  uint16_t line_start() const;
+  ChrRow   fetch_bg_tile(uint16_t v) const;
+
+  void     render_line();
+
+  /* Scanline mode: work out from the current settings at which dot, if
+   * any, sprite 0 will hit on this line, so the flag is set on time
+   * without composing the line dot by dot. Rerun whenever something the
+   * answer depends on changes.
+   */
+  void     predict_sprite_zero();
+  void     render_pixel(uint16_t x);
+  void     output(uint16_t x, uint8_t bg, uint8_t sprite, bool behind,
+                  bool sprite_zero);
+
+  /* CPU cycles, rounded up, from now until dot `dot` of line `line`. */
+  uint64_t cycles_until(uint16_t line, uint16_t dot) const;
+
+public:
+  PPU();
+
+  void       attach(Mapper *mapper);
+  RenderMode get_mode() const { return _mode; }
+  void       set_mode(RenderMode mode);
+
+  /* Compose only every `frames`th frame into the picture (1, the default,
+   * composes all, 0 none), starting with the next frame. Skipped frames
+   * write no pixels but still set everything the CPU can see: vblank and
+   * NMI timing, sprite 0 hit (by testing just the pixels sprite 0 covers)
+   * and sprite overflow. get_frame() keeps the last composed picture.
+   */
+  void       set_render_interval(uint32_t frames);
+  uint32_t   get_render_interval() const { return _render_interval; }
+
+  /* Register access, `reg` being the address's low three bits. */
+  uint8_t    read_register(uint8_t reg);
+  void       write_register(uint8_t reg, uint8_t data);
+
+  /* $4014: copy 256 bytes into OAM starting at OAMADDR. */
+  void       write_oam_dma(const uint8_t *page);
+
+  /* The mapper's registers were written, which may have switched CHR
+   * banks or mirroring under the current line.
+   */
+  void       mapper_changed();
+
+  /* Simulate forward to CPU cycle `now`. */
+  void       catch_up(uint64_t now);
+
+  /* CPU cycle of the next vblank NMI or cartridge IRQ the PPU will cause,
+   * or NO_EVENT.
+   */
+  uint64_t   next_event() const;
+
+  /* Whether an NMI edge is pending, clearing it. */
+  bool       take_nmi();
+
+  uint64_t   get_frames() const { return _frames; }
+  uint16_t   get_line() const { return _line; }
+  uint16_t   get_dot() const { return _dot; }
+
+  /* The last finished picture as NES palette indices, row by row.
+   *
+   * Pictures are double-buffered: the PPU composes into a back buffer and
+   * swaps it to the front at vblank, so the pointer stays valid and its
+   * contents unchanged for the whole of the next frame, with no copy.
+   * After the next swap the same pointer is the back buffer being drawn
+   * over, so call again each frame. get_frame_number() says which frame
+   * the front picture is (0 before the first).
+   */
+  const uint8_t  *get_frame() const {
+    return _pictures[_back ^ 1].data();
+  }
+  uint64_t        get_frame_number() const { return _front_frame; }
+
+  /* get_frame() as RGBA (see nes_rgba()). Converted only when asked
+   * for, on the first call after each swap, into one 64-byte aligned
+   * buffer allocated by the first call: the pointer never changes and its
+   * contents change only inside this call.
+   */
+  const uint32_t *get_frame_rgba();
+
+  /* The state includes which picture is in front and whether the current
+   * frame is being composed, but not the pictures themselves, the render
+   * mode or the render interval: after a load, get_frame() is valid
+   * again from the first swap that follows a fully composed frame.
+   */
+  void       save(StateWriter &writer) const;
+  void       load(StateReader &reader);
+  void       mark_clean();
+};
@@ -0,0 +1,88 @@
+#include "./log.hpp"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstring>
+
+constexpr size_t LOG_WORDS = (LOG_TEXT_SIZE + 7) / 8;
+
+/*
+ * A slot is stamped with 2 * seq + 1 while record `seq` is being written
+ * into it and 2 * seq + 2 once it is complete. Readers check the stamp
+ * before and after copying, seqlock style. The text is stored as atomic
+ * words so a copy racing with a writer is merely torn, and then discarded,
+ * rather than undefined.
+ */
+struct LogSlot {
+  std::atomic<uint64_t> stamp;
+  std::atomic<uint8_t>  level;
+  std::atomic<uint64_t> words[LOG_WORDS];
+};
+
+static LogSlot               slots[LOG_CAPACITY];
+static std::atomic<uint64_t> head{0};
+
+static const char *const     LEVEL_NAMES[] = {
+    "trace", "debug", "info", "warn", "error", "off",
+};
+
+void log_write(LogLevel level, const char *format, ...) {
+  uint64_t words[LOG_WORDS] = {};
+  va_list  args;
+  va_start(args, format);
+  std::vsnprintf(reinterpret_cast<char *>(words), LOG_TEXT_SIZE, format, args);
+  va_end(args);
+
+  uint64_t seq = head.fetch_add(1, std::memory_order_relaxed);
+  LogSlot &slot = slots[seq % LOG_CAPACITY];
+  slot.stamp.store(2 * seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+  for (size_t i = 0; i < LOG_WORDS; i++) {
+    slot.words[i].store(words[i], std::memory_order_relaxed);
+  }
+  slot.stamp.store(2 * seq + 2, std::memory_order_release);
+}
+
+uint64_t log_head() { return head.load(std::memory_order_acquire); }
+
+bool     log_read(uint64_t &cursor, LogRecord &record) {
+  uint64_t end = head.load(std::memory_order_acquire);
+  if (end > LOG_CAPACITY && cursor < end - LOG_CAPACITY) {
+    cursor = end - LOG_CAPACITY;
+  }
+  while (cursor < end) {
+    LogSlot &slot = slots[cursor % LOG_CAPACITY];
+    uint64_t words[LOG_WORDS];
+    uint64_t before = slot.stamp.load(std::memory_order_acquire);
+    if (before < 2 * cursor + 2) {
+      /// Claimed but not finished yet.
+      return false;
+    }
+    uint8_t level = slot.level.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < LOG_WORDS; i++) {
+      words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (before == 2 * cursor + 2 &&
+        slot.stamp.load(std::memory_order_relaxed) == before) {
+      record.seq = cursor;
+      record.level = static_cast<LogLevel>(level);
+      std::memcpy(record.text, words, LOG_TEXT_SIZE);
+      record.text[LOG_TEXT_SIZE - 1] = '\0';
+      cursor++;
+      return true;
+    }
+    /// Overwritten by a writer that lapped us; move on.
+    cursor++;
+  }
+  return false;
+}
+
+void log_dump(std::FILE *out, uint64_t &cursor) {
+  LogRecord record;
+  while (log_read(cursor, record)) {
+    std::fprintf(out, "[%s] %s\n",
+                 LEVEL_NAMES[static_cast<size_t>(record.level)], record.text);
+  }
+}
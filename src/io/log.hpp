@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+enum class LogLevel : uint8_t {
+  Trace,
+  Debug,
+  Info,
+  Warn,
+  Error,
+  Off,
+};
+
+/* Messages below this level are compiled out: their arguments are not even
+ * evaluated. Override with -DMP6502_LOG_LEVEL=<0..5> (0 = Trace, 5 = Off).
+ */
+#ifndef MP6502_LOG_LEVEL
+#define MP6502_LOG_LEVEL 3
+#endif
+constexpr LogLevel LOG_LEVEL = static_cast<LogLevel>(MP6502_LOG_LEVEL);
+
+constexpr size_t   LOG_CAPACITY = 1024; // Records kept in the ring
+constexpr size_t   LOG_TEXT_SIZE = 120; // Bytes per message, terminator included
+
+/* One message as copied out of the ring. */
+struct LogRecord {
+  uint64_t seq; // Position in the log, counting from 0
+  LogLevel level;
+  char     text[LOG_TEXT_SIZE];
+};
+
+/*
+ * Process-wide in-memory log.
+ *
+ * Messages go into a fixed ring of LOG_CAPACITY records instead of a
+ * stream. Writers claim a slot with one atomic increment and never take a
+ * lock or make a system call, so logging from many machines on many
+ * threads does not serialize them; when the ring wraps the oldest records
+ * are overwritten. Nothing is printed until someone reads the ring.
+ *
+ * Use MP6502_LOG rather than calling log_write() directly so disabled
+ * levels cost nothing.
+ */
+#define MP6502_LOG(level, ...)                                                 \
+  do {                                                                         \
+    if constexpr ((level) >= LOG_LEVEL) {                                      \
+      log_write((level), __VA_ARGS__);                                         \
+    }                                                                          \
+  } while (0)
+
+/* Format a message printf-style into the ring, truncating it to fit. */
+void     log_write(LogLevel level, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* Sequence number the next message will get. */
+uint64_t log_head();
+
+/*
+ * Copy the record at `cursor` into `record` and advance `cursor`. If that
+ * record has already been overwritten, skip to the oldest one still held.
+ * Returns false, leaving `cursor` alone, when there is nothing newer.
+ * Each reader keeps its own cursor; a record still being written is
+ * treated as not there yet.
+ */
+bool     log_read(uint64_t &cursor, LogRecord &record);
+
+/* Print every record from `cursor` on to `out` and advance `cursor`. */
+void     log_dump(std::FILE *out, uint64_t &cursor);
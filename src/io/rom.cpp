@@ -1,9 +1,163 @@
 #include "./rom.hpp"
 
-// Reader::Reader(const std::string &filename) {
-//   _file.open(filename, std::ios::binary);
-//   _file.read(reinterpret_cast<char *>(_rom.data()), _rom.size());
-//   _file.close();
-// }
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-// uint8_t Reader::read(uint16_t addr) const { return _rom[addr]; }
\ No newline at end of file
+Reader::Reader(const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open ROM " + filename);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)INES_HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("ROM too small: " + filename);
+  }
+  _map_size = static_cast<size_t>(st.st_size);
+  void *map = mmap(nullptr, _map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    throw std::runtime_error("cannot map ROM " + filename);
+  }
+  _map = static_cast<const uint8_t *>(map);
+
+  try {
+    parse();
+  } catch (...) {
+    munmap(const_cast<uint8_t *>(_map), _map_size);
+    throw;
+  }
+}
+
+Reader::~Reader() { munmap(const_cast<uint8_t *>(_map), _map_size); }
+
+/*
+ * iNES header layout:
+ *   0-3  "NES" $1A
+ *   4    PRG ROM size, 16KB units (NES 2.0: LSB)
+ *   5    CHR ROM size, 8KB units (NES 2.0: LSB)
+ *   6    NNNN FTBM  mapper D0-D3, four-screen, trainer, battery, mirroring
+ *   7    NNNN xxPV  mapper D4-D7, header version (10 = NES 2.0)
+ *   8    iNES: PRG RAM size, 8KB units. NES 2.0: SSSS NNNN submapper, mapper D8-D11
+ *   9    NES 2.0: CCCC PPPP  CHR/PRG ROM size MSB
+ *   10   NES 2.0: PRG RAM/NVRAM shift counts
+ *   11   NES 2.0: CHR RAM/NVRAM shift counts
+ */
+static size_t nes2_rom_size(uint8_t lsb, uint8_t msb, size_t unit) {
+  if (msb == 0x0F) {
+    /// Exponent-multiplier notation: 2^E * (MM * 2 + 1). E goes up to 63;
+    /// the multiplier takes up to 3 more bits.
+    unsigned exponent = lsb >> 2;
+    if (exponent > std::numeric_limits<size_t>::digits - 3) {
+      throw std::runtime_error("NES 2.0 ROM size exponent too large");
+    }
+    return (size_t{1} << exponent) * ((lsb & 0x03) * 2 + 1);
+  }
+  return ((size_t{msb} << 8) | lsb) * unit;
+}
+
+static size_t nes2_ram_size(uint8_t shifts) {
+  size_t size = 0;
+  for (uint8_t shift : {uint8_t(shifts & 0x0F), uint8_t(shifts >> 4)}) {
+    if (shift != 0) {
+      size += size_t{64} << shift;
+    }
+  }
+  return size;
+}
+
+void Reader::parse() {
+  const uint8_t *h = _map;
+  if (std::memcmp(h, "NES\x1A", 4) != 0) {
+    throw std::runtime_error("not an iNES image");
+  }
+
+  _header.nes2 = (h[7] & 0x0C) == 0x08;
+  _header.battery = h[6] & 0x02;
+  _header.trainer = h[6] & 0x04;
+  if (h[6] & 0x08) {
+    _header.mirroring = Mirroring::FourScreen;
+  } else {
+    _header.mirroring =
+        (h[6] & 0x01) ? Mirroring::Vertical : Mirroring::Horizontal;
+  }
+
+  if (_header.nes2) {
+    _header.mapper = (h[6] >> 4) | (h[7] & 0xF0) | ((h[8] & 0x0F) << 8);
+    _header.submapper = h[8] >> 4;
+    _header.prg_rom_size = nes2_rom_size(h[4], h[9] & 0x0F, PRG_BANK_SIZE);
+    _header.chr_rom_size = nes2_rom_size(h[5], h[9] >> 4, CHR_BANK_SIZE);
+    _header.prg_ram_size = nes2_ram_size(h[10]);
+    _header.chr_ram_size = nes2_ram_size(h[11]);
+  } else {
+    /// Old dumping tools wrote text into bytes 7-15. If the tail is not
+    /// zeroed, byte 7 cannot be trusted for the mapper high nibble.
+    bool dirty = h[12] | h[13] | h[14] | h[15];
+    _header.mapper = (h[6] >> 4) | (dirty ? 0 : (h[7] & 0xF0));
+    _header.submapper = 0;
+    _header.prg_rom_size = h[4] * PRG_BANK_SIZE;
+    _header.chr_rom_size = h[5] * CHR_BANK_SIZE;
+    _header.prg_ram_size = (h[8] == 0 ? 1 : h[8]) * 0x2000;
+    _header.chr_ram_size = _header.chr_rom_size == 0 ? CHR_BANK_SIZE : 0;
+  }
+
+  if (_header.prg_rom_size == 0) {
+    throw std::runtime_error("ROM has no PRG data");
+  }
+  size_t offset = INES_HEADER_SIZE + (_header.trainer ? INES_TRAINER_SIZE : 0);
+  /// Subtract from the file size rather than add up the header's sizes,
+  /// which a crafted header can make wrap around.
+  size_t prg = _header.prg_rom_size;
+  size_t chr = _header.chr_rom_size;
+  if (offset > _map_size || prg > _map_size - offset ||
+      chr > _map_size - offset - prg) {
+    throw std::runtime_error("ROM image is truncated");
+  }
+  _prg = {_map + offset, _header.prg_rom_size};
+  _chr = {_map + offset + _header.prg_rom_size, _header.chr_rom_size};
+}
+
+const RomHeader &Reader::get_header() const { return _header; }
+RomSpan          Reader::get_image() const { return {_map, _map_size}; }
+RomSpan          Reader::get_prg() const { return _prg; }
+RomSpan          Reader::get_chr() const { return _chr; }
+
+const ChrRow *Reader::get_chr_rows() const {
+  if (_chr.size == 0) {
+    return nullptr;
+  }
+  std::call_once(_chr_rows_once, [this] {
+    size_t tiles = _chr.size / 16;
+    _chr_rows = std::make_unique<ChrRow[]>(tiles * 8);
+    for (size_t tile = 0; tile < tiles; tile++) {
+      const uint8_t *planes = _chr.data + tile * 16;
+      for (size_t row = 0; row < 8; row++) {
+        _chr_rows[tile * 8 + row] = decode_chr_row(planes[row], planes[row + 8]);
+      }
+    }
+  });
+  return _chr_rows.get();
+}
+
+RomSpan          Reader::get_prg_bank(size_t index) const {
+  size_t banks = (_prg.size + PRG_BANK_SIZE - 1) / PRG_BANK_SIZE;
+  size_t offset = (index % banks) * PRG_BANK_SIZE;
+  return {_prg.data + offset, std::min(PRG_BANK_SIZE, _prg.size - offset)};
+}
+
+RomSpan Reader::get_chr_bank(size_t index) const {
+  if (_chr.size == 0) {
+    return {nullptr, 0};
+  }
+  size_t banks = (_chr.size + CHR_BANK_SIZE - 1) / CHR_BANK_SIZE;
+  size_t offset = (index % banks) * CHR_BANK_SIZE;
+  return {_chr.data + offset, std::min(CHR_BANK_SIZE, _chr.size - offset)};
+}
+
+uint8_t Reader::read(uint16_t addr) const { return _prg.data[addr % _prg.size]; }
@@ -1,22 +1,110 @@
 #pragma once
 
-#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
 
+constexpr size_t INES_HEADER_SIZE = 16;
+constexpr size_t INES_TRAINER_SIZE = 512;
+constexpr size_t PRG_BANK_SIZE = 0x4000; // 16KB, the unit PRG ROM is sized in
+constexpr size_t CHR_BANK_SIZE = 0x2000; // 8KB, the unit CHR ROM is sized in
+
+/* Read-only view of a block of the ROM image. */
+struct RomSpan {
+  const uint8_t *data;
+  size_t         size;
+};
+
+/* One 8-pixel row of a CHR tile decoded from its two bitplanes: byte i
+ * holds the 2-bit pattern value of pixel i, counting from the left.
+ */
+typedef uint64_t ChrRow;
+
+/* Copy each bit of `b` into its own byte, bit 7 into the lowest byte. */
+inline uint64_t spread_chr_bits(uint8_t b) {
+  uint64_t x = (b * 0x0101010101010101ULL) & 0x0102040810204080ULL;
+  /// Every byte now holds 0 or a single bit; adding 0x7F moves any set bit
+  /// to bit 7 without carrying into the next byte.
+  return ((x + 0x7F7F7F7F7F7F7F7FULL) & 0x8080808080808080ULL) >> 7;
+}
+
+inline ChrRow decode_chr_row(uint8_t lo, uint8_t hi) {
+  return spread_chr_bits(lo) | spread_chr_bits(hi) << 1;
+}
+
+enum class Mirroring {
+  Horizontal,
+  Vertical,
+  FourScreen,
+  SingleLower, // One-screen, first nametable (set by mappers, never by headers)
+  SingleUpper, // One-screen, second nametable
+};
+
+/* Cartridge description decoded from an iNES or NES 2.0 header. */
+struct RomHeader {
+  bool      nes2; // NES 2.0 header (otherwise iNES)
+  uint16_t  mapper;
+  uint8_t   submapper; // NES 2.0 only
+  Mirroring mirroring;
+  bool      battery; // PRG RAM is battery backed
+  bool      trainer; // 512 byte trainer precedes PRG ROM
+  size_t    prg_rom_size;
+  size_t    chr_rom_size; // 0 means the board uses CHR RAM
+  size_t    prg_ram_size;
+  size_t    chr_ram_size;
+};
+
+/*
+ * Cartridge loader.
+ *
+ * Maps a .nes file read-only instead of copying it, parses the header and
+ * exposes PRG and CHR ROM as spans into the mapping. Every Reader of the
+ * same file shares the kernel's page cache copy of it, and every board
+ * built from one Reader shares its pre-decoded CHR ROM.
+ *
+ * Throws std::runtime_error if the file cannot be mapped or is not a valid
+ * iNES / NES 2.0 image.
+ */
 class Reader {
 private:
-  std::array<uint8_t, 0x2000> _rom; // 8KB ROM
-  std::fstream _file;
+  const uint8_t                    *_map; // Start of the mapped file
+  size_t                            _map_size;
+  RomHeader                         _header;
+  RomSpan                           _prg; // PRG ROM
+  RomSpan                           _chr; // CHR ROM (empty for CHR RAM boards)
+  mutable std::once_flag            _chr_rows_once;
+  mutable std::unique_ptr<ChrRow[]> _chr_rows; // Built by get_chr_rows()
+
+  void           parse();
 
 public:
-  Reader(const std::string &filename) {
-    _file.open(filename, std::ios::binary);
-    _file.read(reinterpret_cast<char *>(_rom.data()), _rom.size());
-    _file.close();
-  }
-  uint8_t read(uint16_t addr) const {
-    return _rom[addr];
-  }
-};
\ No newline at end of file
+  Reader(const std::string &filename);
+  ~Reader();
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+
+  const RomHeader &get_header() const;
+
+  /* The whole file, header included. */
+  RomSpan          get_image() const;
+  RomSpan          get_prg() const;
+  RomSpan          get_chr() const;
+
+  /* CHR ROM decoded into 8 ChrRows per 16-byte tile, row r of tile t at
+   * index t * 8 + r. Decoded on the first call
+   * and then shared by every board running this image. Thread-safe.
+   * nullptr for CHR RAM boards.
+   */
+  const ChrRow    *get_chr_rows() const;
+
+  /* 16KB PRG bank `index`, wrapping if the ROM is smaller. */
+  RomSpan          get_prg_bank(size_t index) const;
+
+  /* 8KB CHR bank `index`, wrapping if the ROM is smaller. */
+  RomSpan          get_chr_bank(size_t index) const;
+
+  /* Byte `addr` of PRG ROM, wrapping if the ROM is smaller. */
+  uint8_t          read(uint16_t addr) const;
+};
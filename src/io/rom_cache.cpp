@@ -0,0 +1,64 @@
+#include "./rom_cache.hpp"
+
+#include <cstring>
+
+/* 64-bit FNV-1a. */
+static uint64_t hash_image(RomSpan image) {
+  uint64_t hash = 0xCBF29CE484222325;
+  for (size_t i = 0; i < image.size; i++) {
+    hash = (hash ^ image.data[i]) * 0x100000001B3;
+  }
+  return hash;
+}
+
+static bool same_image(const Reader &a, const Reader &b) {
+  RomSpan x = a.get_image();
+  RomSpan y = b.get_image();
+  return x.size == y.size && std::memcmp(x.data, y.data, x.size) == 0;
+}
+
+RomCache::RomCache() : _hits(0), _misses(0), _bytes_saved(0) {}
+
+RomCache &RomCache::instance() {
+  static RomCache cache;
+  return cache;
+}
+
+std::shared_ptr<const Reader> RomCache::load(const std::string &filename) {
+  /// Map and hash outside the lock; both can take a while for large ROMs.
+  auto     loaded = std::make_shared<const Reader>(filename);
+  uint64_t hash = hash_image(loaded->get_image());
+
+  std::lock_guard<std::mutex> guard(_lock);
+  std::vector<Entry>         &bucket = _images[hash];
+  for (auto it = bucket.begin(); it != bucket.end();) {
+    std::shared_ptr<const Reader> resident = it->lock();
+    if (!resident) {
+      it = bucket.erase(it);
+      continue;
+    }
+    if (same_image(*resident, *loaded)) {
+      _hits++;
+      _bytes_saved += resident->get_image().size;
+      return resident;
+    }
+    ++it;
+  }
+  _misses++;
+  bucket.push_back(loaded);
+  return loaded;
+}
+
+RomCacheStats RomCache::get_stats() const {
+  std::lock_guard<std::mutex> guard(_lock);
+  RomCacheStats               stats = {_hits, _misses, _bytes_saved, 0, 0};
+  for (const auto &[hash, bucket] : _images) {
+    for (const Entry &entry : bucket) {
+      if (std::shared_ptr<const Reader> resident = entry.lock()) {
+        stats.resident_images++;
+        stats.resident_bytes += resident->get_image().size;
+      }
+    }
+  }
+  return stats;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "./rom.hpp"
+
+struct RomCacheStats {
+  uint64_t hits; // Loads answered with an image that was already resident
+  uint64_t misses; // Loads that made a new image resident
+  uint64_t bytes_saved; // Image bytes not duplicated thanks to hits
+  size_t   resident_images; // Distinct images currently alive
+  size_t   resident_bytes; // Total size of those images
+};
+
+/*
+ * Process-wide cache of ROM images, keyed by a hash of their contents.
+ *
+ * Every emulator instance running the same game holds the same immutable
+ * Reader, so N instances cost one copy of the ROM plus their own mutable
+ * state. Entries are weak: an image is released when the last instance
+ * using it goes away. Safe to call from multiple threads.
+ */
+class RomCache {
+private:
+  typedef std::weak_ptr<const Reader> Entry;
+
+  mutable std::mutex                               _lock;
+  std::unordered_map<uint64_t, std::vector<Entry>> _images; // Content hash -> images with that hash
+  uint64_t                                         _hits;
+  uint64_t                                         _misses;
+  uint64_t                                         _bytes_saved;
+
+  RomCache();
+
+public:
+  static RomCache &instance();
+
+  /* Load `filename`, or return the resident image with identical contents. */
+  std::shared_ptr<const Reader> load(const std::string &filename);
+
+  RomCacheStats                 get_stats() const;
+};
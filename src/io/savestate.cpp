@@ -0,0 +1,116 @@
+#include "./savestate.hpp"
+#include "../dev/nes6502.hpp"
+
+/* Identity of a full state: FNV-1a over its bytes after the header, a
+ * word at a time in four interleaved lanes so the multiplies overlap,
+ * then the lanes folded together. Every step is a bijection, so two
+ * states that differ in any one word never share an identity.
+ */
+static uint64_t hash_state(const uint8_t *buf, size_t size) {
+  constexpr uint64_t BASIS = 0xCBF29CE484222325;
+  constexpr uint64_t PRIME = 0x100000001B3;
+  uint64_t           h0 = BASIS, h1 = BASIS + 1, h2 = BASIS + 2, h3 = BASIS + 3;
+  size_t             i = sizeof(StateHeader);
+  for (; i + 32 <= size; i += 32) {
+    uint64_t words[4];
+    std::memcpy(words, buf + i, 32);
+    h0 = (h0 ^ words[0]) * PRIME;
+    h1 = (h1 ^ words[1]) * PRIME;
+    h2 = (h2 ^ words[2]) * PRIME;
+    h3 = (h3 ^ words[3]) * PRIME;
+  }
+  uint64_t hash = (((h0 ^ h1) * PRIME ^ h2) * PRIME ^ h3) * PRIME;
+  for (; i < size; i++) {
+    hash = (hash ^ buf[i]) * PRIME;
+  }
+  return hash;
+}
+
+/* Write a state of `kind` into `buf`, or just measure it if `buf` is null. */
+static size_t write_state(const NES6502 &cpu, StateKind kind, uint8_t *buf,
+                          size_t capacity) {
+  StateWriter writer(buf, capacity, kind);
+  writer.put(StateHeader{});
+  cpu.save(writer);
+  if (buf == nullptr) {
+    return writer.get_size();
+  }
+  if (writer.overflowed()) {
+    throw std::runtime_error("Save state buffer is too small");
+  }
+  /// The size and identity are only known once everything has been
+  /// written.
+  StateHeader header{STATE_MAGIC, STATE_VERSION, kind,
+                     static_cast<uint32_t>(writer.get_size()),
+                     kind == StateKind::Delta
+                         ? cpu.get_bus().get_base_id()
+                         : hash_state(buf, writer.get_size())};
+  std::memcpy(buf, &header, sizeof(header));
+  return writer.get_size();
+}
+
+/* Check the header of a state expected to be of `kind`. */
+static StateHeader read_header(StateReader &reader, StateKind kind,
+                               size_t size) {
+  StateHeader header = reader.get<StateHeader>();
+  if (header.magic != STATE_MAGIC || header.kind != kind) {
+    throw std::runtime_error(kind == StateKind::Full ? "Not a save state"
+                                                     : "Not a delta state");
+  }
+  if (header.version != STATE_VERSION) {
+    throw std::runtime_error("Unsupported save state version: " +
+                             std::to_string(header.version));
+  }
+  if (header.size > size) {
+    throw std::runtime_error("Save state is truncated");
+  }
+  return header;
+}
+
+size_t state_size(const NES6502 &cpu) {
+  return write_state(cpu, StateKind::Full, nullptr, 0);
+}
+
+size_t save_state(NES6502 &cpu, uint8_t *buf, size_t capacity) {
+  size_t      size = write_state(cpu, StateKind::Full, buf, capacity);
+  StateHeader header;
+  std::memcpy(&header, buf, sizeof(header));
+  cpu.get_bus().mark_clean(header.base_id);
+  return size;
+}
+
+void load_state(NES6502 &cpu, const uint8_t *buf, size_t size) {
+  StateReader reader(buf, size, StateKind::Full);
+  StateHeader header = read_header(reader, StateKind::Full, size);
+  cpu.load(reader);
+  cpu.get_bus().mark_clean(header.base_id);
+}
+
+size_t delta_size(const NES6502 &cpu) {
+  return write_state(cpu, StateKind::Delta, nullptr, 0);
+}
+
+size_t max_delta_size(const NES6502 &cpu) {
+  StateWriter writer(nullptr, 0, StateKind::Delta, true);
+  writer.put(StateHeader{});
+  cpu.save(writer);
+  return writer.get_size();
+}
+
+size_t save_delta(const NES6502 &cpu, uint8_t *buf, size_t capacity) {
+  return write_state(cpu, StateKind::Delta, buf, capacity);
+}
+
+void load_delta(NES6502 &cpu, const uint8_t *base, size_t base_size,
+                const uint8_t *delta, size_t delta_size) {
+  StateReader reader(delta, delta_size, StateKind::Delta);
+  StateHeader header = read_header(reader, StateKind::Delta, delta_size);
+  /// Check both headers before touching the machine.
+  StateReader base_reader(base, base_size, StateKind::Full);
+  if (read_header(base_reader, StateKind::Full, base_size).base_id !=
+      header.base_id) {
+    throw std::runtime_error("Delta state was taken against another base");
+  }
+  load_state(cpu, base, base_size);
+  cpu.load(reader);
+}
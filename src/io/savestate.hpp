@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+class NES6502;
+
+constexpr uint32_t STATE_MAGIC = 0x5453504D; // "MPST" in little-endian order
+constexpr uint16_t STATE_VERSION = 4;
+
+enum class StateKind : uint16_t {
+  Full, // Self-contained
+  Delta, // Pages written since a base state, plus all non-paged state
+};
+
+/* Fixed header at the start of every save state. */
+struct StateHeader {
+  uint32_t  magic;
+  uint16_t  version;
+  StateKind kind;
+  uint32_t  size; // Total size of the state in bytes, header included
+  uint64_t  base_id; // Full: hash identifying it as a base. Delta: its base's
+};
+
+/*
+ * Sequential writer into a caller-supplied buffer.
+ *
+ * Never allocates. Writing past the end of the buffer only advances the
+ * position, so a writer over a null buffer measures how large a state is,
+ * and overflowed() reports a buffer that was too small. Values are stored
+ * in host byte order: states are meant to be restored on the machine (or
+ * at least the architecture) that produced them.
+ */
+class StateWriter {
+private:
+  uint8_t  *_buf;
+  size_t    _capacity;
+  size_t    _pos;
+  StateKind _kind;
+  bool      _all_dirty; // Treat every page as dirty (to size the largest delta)
+
+public:
+  StateWriter(uint8_t *buf, size_t capacity, StateKind kind = StateKind::Full,
+              bool all_dirty = false)
+      : _buf(buf), _capacity(capacity), _pos(0), _kind(kind),
+        _all_dirty(all_dirty) {}
+
+  void write(const void *src, size_t size) {
+    if (_pos + size <= _capacity) {
+      std::memcpy(_buf + _pos, src, size);
+    }
+    _pos += size;
+  }
+
+  template <typename T> void put(T value) { write(&value, sizeof(T)); }
+
+  /* Write `pages` 256-byte pages of `base`. A full state stores them all;
+   * a delta stores only those whose flag in `dirty` is set.
+   */
+  void write_pages(const uint8_t *base, const uint8_t *dirty, size_t pages) {
+    if (_kind == StateKind::Full) {
+      write(base, pages * 0x100);
+      return;
+    }
+    uint16_t count = 0;
+    for (size_t i = 0; i < pages; i++) {
+      count += _all_dirty || dirty[i] != 0;
+    }
+    put(count);
+    for (size_t i = 0; i < pages; i++) {
+      if (_all_dirty || dirty[i]) {
+        put<uint16_t>(i);
+        write(base + i * 0x100, 0x100);
+      }
+    }
+  }
+
+  size_t get_size() const { return _pos; }
+  bool   overflowed() const { return _pos > _capacity; }
+};
+
+/*
+ * Sequential reader over a save state.
+ *
+ * Throws std::runtime_error if a read runs past the end of the state.
+ */
+class StateReader {
+private:
+  const uint8_t *_buf;
+  size_t         _size;
+  size_t         _pos;
+  StateKind      _kind;
+
+public:
+  StateReader(const uint8_t *buf, size_t size, StateKind kind = StateKind::Full)
+      : _buf(buf), _size(size), _pos(0), _kind(kind) {}
+
+  void read(void *dst, size_t size) {
+    if (_pos + size > _size) {
+      throw std::runtime_error("Save state is truncated");
+    }
+    std::memcpy(dst, _buf + _pos, size);
+    _pos += size;
+  }
+
+  template <typename T> T get() {
+    T value;
+    read(&value, sizeof(T));
+    return value;
+  }
+
+  /* Counterpart of StateWriter::write_pages(). Pages restored from a delta
+   * are flagged dirty again, since they still differ from the base.
+   */
+  void read_pages(uint8_t *base, uint8_t *dirty, size_t pages) {
+    if (_kind == StateKind::Full) {
+      read(base, pages * 0x100);
+      return;
+    }
+    uint16_t count = get<uint16_t>();
+    for (uint16_t n = 0; n < count; n++) {
+      uint16_t i = get<uint16_t>();
+      if (i >= pages) {
+        throw std::runtime_error("Save state page out of range");
+      }
+      read(base + i * 0x100, 0x100);
+      dirty[i] = 1;
+    }
+  }
+
+  size_t get_pos() const { return _pos; }
+};
+
+/* Bytes save_state() needs for `cpu` and everything attached to its Bus. */
+size_t state_size(const NES6502 &cpu);
+
+/* Serialize `cpu`, its Bus and every device on it into `buf`, and make it
+ * the base later deltas are taken against. Returns the number of bytes
+ * written. Does not allocate. Throws std::runtime_error if `capacity` is
+ * smaller than state_size().
+ */
+size_t save_state(NES6502 &cpu, uint8_t *buf, size_t capacity);
+
+/* Restore a state produced by save_state() into `cpu`, and make it the
+ * base. The same cartridge must already be inserted. Throws
+ * std::runtime_error if the state is malformed, from another version, or
+ * for a different cartridge.
+ */
+void   load_state(NES6502 &cpu, const uint8_t *buf, size_t size);
+
+/* Bytes save_delta() needs for `cpu` right now. */
+size_t delta_size(const NES6502 &cpu);
+
+/* Upper bound on delta_size() for `cpu`, reached when every page is dirty. */
+size_t max_delta_size(const NES6502 &cpu);
+
+/* Serialize `cpu` as a delta against its base state: the registers, clock
+ * and device state in full, and only the RAM pages written since the base
+ * was saved or loaded. Throws std::runtime_error if `capacity` is smaller
+ * than delta_size().
+ */
+size_t save_delta(const NES6502 &cpu, uint8_t *buf, size_t capacity);
+
+/* Restore the full state `base`, then apply `delta` (saved against it) on
+ * top. Throws std::runtime_error, leaving `cpu` untouched, if the delta
+ * was taken against a different base.
+ */
+void   load_delta(NES6502 &cpu, const uint8_t *base, size_t base_size,
+                  const uint8_t *delta, size_t delta_size);
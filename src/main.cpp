@@ -1,9 +1,179 @@
-#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
 
 #include "dev/bus.hpp"
+#include "dev/nes6502.hpp"
+#include "io/log.hpp"
+#include "io/rom_cache.hpp"
+#include "sys/scheduler.hpp"
 
-int main() {
-  std::cout << "Hello, World!" << std::endl;
-  Bus bus;
-  return 1;
-}
\ No newline at end of file
+/*
+ * Headless runner.
+ *
+ * Loads a ROM and runs it for a number of frames or CPU cycles as fast as
+ * possible, with no video or audio output and no throttling, then prints
+ * emulated cycles, frames and instructions per second of wall time.
+ *
+ * Whatever the emulator logged is printed to stderr after the run, so
+ * logging never competes with the measurement.
+ *
+ * With --render-every N the PPU composes only every Nth frame into its
+ * picture, or none with N = 0; everything the CPU can observe stays exact,
+ * so the run is otherwise identical. The runner then first times a pass
+ * that composes every frame and reports the speedup over it.
+ *
+ * With --min-fps the exit status also serves as a regression gate: 0 if
+ * the run reached that many frames per second, 2 if it did not.
+ */
+
+constexpr uint64_t DEFAULT_FRAMES = 600; // 10 seconds of emulated time
+constexpr double   NTSC_FRAMES_PER_SEC = 60.0988;
+
+static void usage(const char *prog) {
+  std::fprintf(stderr,
+               "usage: %s <rom.nes> [--frames N | --cycles N] [--lockstep]\n"
+               "          [--render-every N] [--min-fps F]\n",
+               prog);
+}
+
+/* Parse a positive decimal count, or also 0 if `allow_zero`. */
+static bool parse_count(const char *arg, uint64_t &out,
+                        bool allow_zero = false) {
+  char *end = nullptr;
+  out = std::strtoull(arg, &end, 10);
+  return end != arg && *end == '\0' && (out > 0 || allow_zero);
+}
+
+struct RunResult {
+  uint64_t cycles;
+  uint64_t instructions;
+  double   secs;
+};
+
+/* Run `rom` on a fresh console for `frames` frames, or `cycles` cycles if
+ * nonzero, composing one frame in `render_every`.
+ */
+static RunResult run(std::shared_ptr<const Reader> rom, SyncMode mode,
+                     uint64_t frames, uint64_t cycles, uint32_t render_every) {
+  Bus     bus;
+  NES6502 cpu(bus);
+  bus.insert_cartridge(std::move(rom));
+  bus.get_ppu().set_render_interval(render_every);
+  cpu.reset();
+  Scheduler scheduler(cpu, mode);
+
+  uint64_t start_cycles = bus.get_cycles();
+  uint64_t start_instructions = cpu.get_instructions();
+  auto     start = std::chrono::steady_clock::now();
+  if (cycles > 0) {
+    scheduler.run_cycles(cycles);
+  } else {
+    for (uint64_t f = 0; f < frames; f++) {
+      scheduler.run_frame();
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  return {bus.get_cycles() - start_cycles,
+          cpu.get_instructions() - start_instructions,
+          std::chrono::duration<double>(end - start).count()};
+}
+
+int main(int argc, char **argv) {
+  const char *rom_path = nullptr;
+  uint64_t    frames = DEFAULT_FRAMES;
+  uint64_t    cycles = 0; // Nonzero: run this many cycles instead of frames
+  SyncMode    mode = SyncMode::Batched;
+  uint64_t    render_every = 1;
+  double      min_fps = 0;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--frames") == 0 && has_value) {
+      if (!parse_count(argv[++i], frames)) {
+        usage(argv[0]);
+        return 1;
+      }
+      cycles = 0;
+    } else if (std::strcmp(argv[i], "--cycles") == 0 && has_value) {
+      if (!parse_count(argv[++i], cycles)) {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "--lockstep") == 0) {
+      mode = SyncMode::Lockstep;
+    } else if (std::strcmp(argv[i], "--render-every") == 0 && has_value) {
+      if (!parse_count(argv[++i], render_every, true) ||
+          render_every > UINT32_MAX) {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "--min-fps") == 0 && has_value) {
+      min_fps = std::atof(argv[++i]);
+    } else if (argv[i][0] != '-' && rom_path == nullptr) {
+      rom_path = argv[i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (rom_path == nullptr) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    std::shared_ptr<const Reader> rom = RomCache::instance().load(rom_path);
+    RunResult                     baseline = {0, 0, 0};
+    if (render_every != 1) {
+      baseline = run(rom, mode, frames, cycles, 1);
+    }
+    RunResult result = run(rom, mode, frames, cycles, render_every);
+
+    uint64_t  ran_cycles = result.cycles;
+    uint64_t  ran_instructions = result.instructions;
+    double    secs = result.secs;
+    double ran_frames = double(ran_cycles) * 2 / CPU_CYCLES_PER_TWO_FRAMES;
+    double fps = ran_frames / secs;
+
+    std::printf("rom:          %s\n", rom_path);
+    std::printf("mode:         %s\n",
+                mode == SyncMode::Batched ? "batched" : "lockstep");
+    std::printf("cycles:       %llu\n", (unsigned long long)ran_cycles);
+    std::printf("frames:       %.1f\n", ran_frames);
+    std::printf("instructions: %llu\n", (unsigned long long)ran_instructions);
+    std::printf("wall time:    %.3f s\n", secs);
+    std::printf("cycles/s:     %.0f (%.1fx NTSC)\n", ran_cycles / secs,
+                fps / NTSC_FRAMES_PER_SEC);
+    std::printf("frames/s:     %.1f\n", fps);
+    std::printf("instr/s:      %.0f\n", ran_instructions / secs);
+    if (render_every != 1) {
+      if (render_every == 0) {
+        std::printf("render every: never\n");
+      } else {
+        std::printf("render every: %llu frames\n",
+                    (unsigned long long)render_every);
+      }
+      std::printf("speedup:      %.2fx over composing every frame\n",
+                  baseline.secs / secs);
+    }
+
+    uint64_t log_cursor = 0;
+    log_dump(stderr, log_cursor);
+
+    if (min_fps > 0 && fps < min_fps) {
+      std::fprintf(stderr, "FAIL: %.1f frames/s is below --min-fps %.1f\n",
+                   fps, min_fps);
+      return 2;
+    }
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "error: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "./arena.hpp"
+
+#include <new>
+#include <stdexcept>
+
+MachineArena::MachineArena(size_t capacity, std::shared_ptr<const Reader> rom)
+    : _capacity(capacity), _rom(std::move(rom)), _free_count(capacity) {
+  _slots = std::make_unique<Slot[]>(capacity);
+  _free = std::make_unique<uint32_t[]>(capacity);
+  _live = std::make_unique<bool[]>(capacity);
+  /// Hand slots out lowest first.
+  for (size_t i = 0; i < capacity; i++) {
+    _free[i] = static_cast<uint32_t>(capacity - 1 - i);
+  }
+}
+
+MachineArena::~MachineArena() {
+  for (size_t i = 0; i < _capacity; i++) {
+    if (_live[i]) {
+      std::launder(reinterpret_cast<Machine *>(_slots[i].machine))->~Machine();
+    }
+  }
+}
+
+Machine *MachineArena::build(size_t slot) {
+  Machine *machine = new (_slots[slot].machine) Machine();
+  if (_rom != nullptr) {
+    try {
+      machine->bus.insert_cartridge(_rom, _slots[slot].mapper);
+    } catch (...) {
+      machine->~Machine();
+      throw;
+    }
+  }
+  machine->cpu.reset();
+  return machine;
+}
+
+size_t MachineArena::slot_of(const Machine *machine) const {
+  return reinterpret_cast<const Slot *>(machine) - _slots.get();
+}
+
+Machine *MachineArena::create() {
+  if (_free_count == 0) {
+    throw std::runtime_error("Machine arena is full");
+  }
+  size_t   slot = _free[_free_count - 1];
+  Machine *machine = build(slot);
+  _free_count--;
+  _live[slot] = true;
+  return machine;
+}
+
+void MachineArena::destroy(Machine *machine) {
+  size_t slot = slot_of(machine);
+  machine->~Machine();
+  _live[slot] = false;
+  _free[_free_count++] = static_cast<uint32_t>(slot);
+}
+
+Machine *MachineArena::recycle(Machine *machine) {
+  size_t slot = slot_of(machine);
+  machine->~Machine();
+  try {
+    return build(slot);
+  } catch (...) {
+    _live[slot] = false;
+    _free[_free_count++] = static_cast<uint32_t>(slot);
+    throw;
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "../io/rom.hpp"
+#include "./machine.hpp"
+
+/*
+ * Fixed-capacity slab of Machines for campaigns that create and discard
+ * huge numbers of short-lived instances (fuzzing, search).
+ *
+ * The constructor makes the only allocations: one block of slots, each
+ * holding a Machine and storage for its cartridge board, and a free list.
+ * Machines from create() are reset, with the cartridge inserted if any.
+ * create() and destroy() construct and destroy in place and recycle()
+ * puts a machine back to its power-on state in its own slot, so none of
+ * them calls malloc or free. The ROM image is shared, not copied.
+ */
+class MachineArena {
+private:
+  struct alignas(64) Slot {
+    alignas(Machine) uint8_t machine[sizeof(Machine)];
+    alignas(MAPPER_STORAGE_ALIGN) uint8_t mapper[MAPPER_STORAGE_SIZE];
+  };
+
+  size_t                        _capacity;
+  std::shared_ptr<const Reader> _rom;
+  std::unique_ptr<Slot[]>       _slots;
+  std::unique_ptr<uint32_t[]>   _free; // Stack of free slot indices
+  std::unique_ptr<bool[]>       _live; // Whether each slot holds a machine
+  size_t                        _free_count;
+
+  Machine                      *build(size_t slot);
+  size_t                        slot_of(const Machine *machine) const;
+
+public:
+  /* Room for `capacity` machines, each with `rom` inserted if given. */
+  MachineArena(size_t capacity, std::shared_ptr<const Reader> rom = nullptr);
+  ~MachineArena();
+  MachineArena(const MachineArena &) = delete;
+  MachineArena &operator=(const MachineArena &) = delete;
+
+  size_t   capacity() const { return _capacity; }
+  size_t   in_use() const { return _capacity - _free_count; }
+
+  /* Construct a powered-on machine in a free slot. Throws
+   * std::runtime_error if every slot is taken or the ROM's mapper is
+   * unsupported.
+   */
+  Machine *create();
+
+  /* Destroy a machine from create() and free its slot. */
+  void     destroy(Machine *machine);
+
+  /* Put a machine back to its power-on state without giving up its slot.
+   * Returns the same machine.
+   */
+  Machine *recycle(Machine *machine);
+};
@@ -0,0 +1,75 @@
+#include "./batch.hpp"
+
+#include <new>
+
+Batch::Batch(size_t size, std::shared_ptr<const Reader> rom)
+    : _size(size), _constructed(0) {
+  _machines = std::make_unique<MachineSlot[]>(size);
+  try {
+    while (_constructed < size) {
+      Machine *machine = new (&_machines[_constructed]) Machine();
+      /// Counted only once constructed, so destroy() never runs a
+      /// destructor on storage whose constructor threw.
+      _constructed++;
+      if (rom != nullptr) {
+        machine->bus.insert_cartridge(rom);
+      }
+      machine->cpu.reset();
+    }
+  } catch (...) {
+    destroy();
+    throw;
+  }
+  _registers.pc.resize(size);
+  _registers.acc.resize(size);
+  _registers.irx.resize(size);
+  _registers.iry.resize(size);
+  _registers.stp.resize(size);
+  _registers.status.resize(size);
+  _registers.cycles.resize(size);
+}
+
+Batch::~Batch() { destroy(); }
+
+void Batch::destroy() {
+  for (size_t i = 0; i < _constructed; i++) {
+    get_machine(i).~Machine();
+  }
+  _constructed = 0;
+}
+
+Machine &Batch::get_machine(size_t index) {
+  return *std::launder(reinterpret_cast<Machine *>(&_machines[index]));
+}
+
+void Batch::reset() {
+  for (size_t i = 0; i < _size; i++) {
+    get_machine(i).cpu.reset();
+  }
+}
+
+void Batch::run_frame() {
+  for (size_t i = 0; i < _size; i++) {
+    get_machine(i).scheduler.run_frame();
+  }
+}
+
+void Batch::run_cycles(uint64_t cycles) {
+  for (size_t i = 0; i < _size; i++) {
+    get_machine(i).scheduler.run_cycles(cycles);
+  }
+}
+
+const BatchRegisters &Batch::get_registers() {
+  for (size_t i = 0; i < _size; i++) {
+    const Machine &machine = get_machine(i);
+    _registers.pc[i] = machine.cpu.get_pc();
+    _registers.acc[i] = machine.cpu.get_acc();
+    _registers.irx[i] = machine.cpu.get_irx();
+    _registers.iry[i] = machine.cpu.get_iry();
+    _registers.stp[i] = machine.cpu.get_stp();
+    _registers.status[i] = machine.cpu.get_status();
+    _registers.cycles[i] = machine.bus.get_cycles();
+  }
+  return _registers;
+}
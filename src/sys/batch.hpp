@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../io/rom.hpp"
+#include "./machine.hpp"
+
+/* Registers of every machine in a batch, one array per register. */
+struct BatchRegisters {
+  std::vector<uint16_t> pc;
+  std::vector<uint8_t>  acc;
+  std::vector<uint8_t>  irx;
+  std::vector<uint8_t>  iry;
+  std::vector<uint8_t>  stp;
+  std::vector<uint8_t>  status;
+  std::vector<uint64_t> cycles; // Bus master clock
+};
+
+/*
+ * Many independent machines stepped together by one thread.
+ *
+ * The machines sit back to back in one cache-line aligned allocation,
+ * each with its RAM inline, and run_frame() runs each for a frame in
+ * turn. The interpreter's handlers and opcode table stay hot across the
+ * whole batch, and each machine's working set (registers, page table, RAM)
+ * is touched in one burst instead of being interleaved with the others.
+ *
+ * get_registers() gathers the registers into structure-of-arrays form for
+ * callers that consume the whole batch at once (observations for RL,
+ * comparisons across test instances).
+ */
+class Batch {
+private:
+  /* Uninitialised storage for one Machine. */
+  struct alignas(Machine) MachineSlot {
+    uint8_t bytes[sizeof(Machine)];
+  };
+
+  size_t                         _size;
+  std::unique_ptr<MachineSlot[]> _machines;
+  size_t                         _constructed; // Machines constructed so far
+  BatchRegisters                 _registers;
+
+  void                           destroy();
+
+public:
+  /* Build `size` machines, with `rom` inserted in each if given, and
+   * reset them. Throws std::runtime_error if the ROM's mapper is
+   * unsupported.
+   */
+  Batch(size_t size, std::shared_ptr<const Reader> rom = nullptr);
+  ~Batch();
+  Batch(const Batch &) = delete;
+  Batch &operator=(const Batch &) = delete;
+
+  size_t                size() const { return _size; }
+  Machine              &get_machine(size_t index);
+
+  /* Reset the CPU of every machine. */
+  void                  reset();
+
+  /* Run every machine to the end of its next frame. */
+  void                  run_frame();
+
+  /* Run every machine for at least `cycles` CPU cycles. */
+  void                  run_cycles(uint64_t cycles);
+
+  /* Gather every machine's registers. Does not allocate. */
+  const BatchRegisters &get_registers();
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+
+#include "../dev/bus.hpp"
+#include "../dev/nes6502.hpp"
+#include "./scheduler.hpp"
+
+/*
+ * One complete console: a CPU, the Bus it is attached to and the scheduler
+ * driving them, in one cache-aligned block with no heap allocations of its
+ * own (an inserted cartridge adds its mapper, and the first request for an
+ * RGBA picture its buffer).
+ *
+ * The CPU comes first so its registers sit right before the Bus's internal
+ * RAM, and zero page and stack accesses touch lines adjacent to the CPU
+ * state. The CPU only stores a reference to the Bus, so it may be
+ * constructed before it. A Machine can be placed anywhere, including back
+ * to back with others in a batch's arena.
+ */
+struct Machine {
+  NES6502   cpu;
+  Bus       bus;
+  Scheduler scheduler;
+
+  /// addressof() only takes the not yet constructed Bus's address, which
+  /// GCC would otherwise flag as a use of an uninitialised member.
+  Machine() : cpu(*std::addressof(bus)), bus(), scheduler(cpu) {}
+  Machine(const Machine &) = delete;
+  Machine &operator=(const Machine &) = delete;
+};
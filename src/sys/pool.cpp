@@ -0,0 +1,204 @@
+#include "./pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+InstancePool::InstancePool(size_t instances, std::shared_ptr<const Reader> rom,
+                           size_t workers)
+    : _instances(instances), _worker_count(std::max<size_t>(workers, 1)),
+      _rom(std::move(rom)), _job(Job::None), _generation(0), _pending(0),
+      _remaining(0), _aborted(false) {
+  _workers = std::make_unique<Worker[]>(_worker_count);
+  for (size_t w = 0; w < _worker_count; w++) {
+    Worker &worker = _workers[w];
+    worker.tasks = std::make_unique<size_t[]>(std::max<size_t>(instances, 1));
+    worker.head = 0;
+    worker.count = 0;
+    worker.stats = WorkerStats{};
+  }
+  for (size_t w = 0; w < _worker_count; w++) {
+    _workers[w].thread = std::thread(&InstancePool::worker_main, this, w);
+  }
+  try {
+    dispatch(Job::Build);
+  } catch (...) {
+    dispatch(Job::Stop);
+    for (size_t w = 0; w < _worker_count; w++) {
+      _workers[w].thread.join();
+    }
+    throw;
+  }
+}
+
+InstancePool::~InstancePool() {
+  dispatch(Job::Stop);
+  for (size_t w = 0; w < _worker_count; w++) {
+    _workers[w].thread.join();
+  }
+}
+
+size_t   InstancePool::size() const { return _instances.size(); }
+size_t   InstancePool::worker_count() const { return _worker_count; }
+Machine &InstancePool::get_machine(size_t index) {
+  return _instances[index]->machine;
+}
+const WorkerStats &InstancePool::get_worker_stats(size_t worker) const {
+  return _workers[worker].stats;
+}
+
+void InstancePool::reset() {
+  for (auto &instance : _instances) {
+    instance->machine.cpu.reset();
+  }
+}
+
+void InstancePool::run_frames(uint64_t frames) {
+  if (frames == 0 || _instances.empty()) {
+    return;
+  }
+  /// Start from empty deques: a run that threw may have left tasks queued.
+  for (size_t w = 0; w < _worker_count; w++) {
+    _workers[w].head = 0;
+    _workers[w].count = 0;
+  }
+  /// Instance i starts on worker i % N, the worker that built it.
+  for (size_t i = 0; i < _instances.size(); i++) {
+    _instances[i]->frames_left = frames;
+    Worker &worker = _workers[i % _worker_count];
+    worker.tasks[(worker.head + worker.count) % _instances.size()] = i;
+    worker.count++;
+  }
+  _remaining.store(frames * _instances.size(), std::memory_order_relaxed);
+  _aborted.store(false, std::memory_order_relaxed);
+  dispatch(Job::Run);
+}
+
+void InstancePool::dispatch(Job job) {
+  std::unique_lock<std::mutex> guard(_job_lock);
+  _job = job;
+  _generation++;
+  _pending = _worker_count;
+  _error = nullptr;
+  _job_ready.notify_all();
+  _job_done.wait(guard, [this] { return _pending == 0; });
+  if (_error != nullptr) {
+    std::rethrow_exception(_error);
+  }
+}
+
+void InstancePool::worker_main(size_t self) {
+  uint64_t seen = 0;
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> guard(_job_lock);
+      _job_ready.wait(guard, [&] { return _generation != seen; });
+      seen = _generation;
+      job = _job;
+    }
+    std::exception_ptr error;
+    try {
+      if (job == Job::Build) {
+        build(self);
+      } else if (job == Job::Run) {
+        run(self);
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> guard(_job_lock);
+      if (error != nullptr && _error == nullptr) {
+        _error = error;
+      }
+      if (--_pending == 0) {
+        _job_done.notify_one();
+      }
+    }
+    if (job == Job::Stop) {
+      return;
+    }
+  }
+}
+
+void InstancePool::build(size_t self) {
+  for (size_t i = self; i < _instances.size(); i += _worker_count) {
+    _instances[i] = std::make_unique<Instance>();
+    if (_rom != nullptr) {
+      _instances[i]->machine.bus.insert_cartridge(_rom);
+    }
+    _instances[i]->machine.cpu.reset();
+  }
+}
+
+void InstancePool::run(size_t self) {
+  WorkerStats &stats = _workers[self].stats;
+  auto         start = std::chrono::steady_clock::now();
+  while (_remaining.load(std::memory_order_acquire) > 0 &&
+         !_aborted.load(std::memory_order_acquire)) {
+    size_t index;
+    if (!pop(self, index)) {
+      if (!steal(self, index)) {
+        std::this_thread::yield();
+        continue;
+      }
+      stats.steals++;
+    }
+    Instance &instance = *_instances[index];
+    auto      begin = std::chrono::steady_clock::now();
+    try {
+      instance.machine.scheduler.run_frame();
+    } catch (...) {
+      /// Its quanta will never be counted off; let the others stop.
+      _aborted.store(true, std::memory_order_release);
+      throw;
+    }
+    auto end = std::chrono::steady_clock::now();
+    stats.busy_ns +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+            .count();
+    stats.quanta++;
+    if (--instance.frames_left > 0) {
+      push(self, index);
+    }
+    _remaining.fetch_sub(1, std::memory_order_release);
+  }
+  auto end = std::chrono::steady_clock::now();
+  stats.wall_ns +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  stats.utilization =
+      stats.wall_ns == 0 ? 0.0 : double(stats.busy_ns) / stats.wall_ns;
+}
+
+bool InstancePool::pop(size_t self, size_t &instance) {
+  Worker                     &worker = _workers[self];
+  std::lock_guard<std::mutex> guard(worker.lock);
+  if (worker.count == 0) {
+    return false;
+  }
+  instance = worker.tasks[worker.head];
+  worker.head = (worker.head + 1) % _instances.size();
+  worker.count--;
+  return true;
+}
+
+bool InstancePool::steal(size_t self, size_t &instance) {
+  for (size_t n = 1; n < _worker_count; n++) {
+    Worker                     &victim = _workers[(self + n) % _worker_count];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (victim.count == 0) {
+      continue;
+    }
+    victim.count--;
+    instance = victim.tasks[(victim.head + victim.count) % _instances.size()];
+    return true;
+  }
+  return false;
+}
+
+void InstancePool::push(size_t self, size_t instance) {
+  Worker                     &worker = _workers[self];
+  std::lock_guard<std::mutex> guard(worker.lock);
+  worker.tasks[(worker.head + worker.count) % _instances.size()] = instance;
+  worker.count++;
+}
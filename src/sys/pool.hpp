@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../io/rom.hpp"
+#include "./machine.hpp"
+
+struct WorkerStats {
+  uint64_t quanta; // Frames run
+  uint64_t steals; // Instances taken from another worker's deque
+  uint64_t busy_ns; // Time spent running frames
+  uint64_t wall_ns; // Time spent in run_frames(), busy or not
+  double   utilization; // busy_ns / wall_ns
+};
+
+/*
+ * Many independent machines spread over a fixed set of worker threads.
+ *
+ * Every instance is its own cache-line aligned allocation, built by the
+ * worker it is first assigned to so its memory is first touched on that
+ * worker's node, and shares nothing mutable with the others: only the
+ * read-only ROM image is common. run_frames() hands each worker an equal
+ * share of the instances in a private deque. A worker runs the instance
+ * at the front of its deque for one frame and requeues it at the back, so
+ * its instances advance round robin; a worker whose deque is empty steals
+ * from the back of another's.
+ *
+ * Deques are guarded by per-worker mutexes, taken once per frame-sized
+ * quantum, which is cheap next to the quantum itself.
+ */
+class InstancePool {
+private:
+  enum class Job { None, Build, Run, Stop };
+
+  /* Storage for one instance, padded so no two share a cache line. */
+  struct alignas(64) Instance {
+    Machine  machine;
+    uint64_t frames_left; // Frames still to run in the current run_frames()
+
+    Instance() : frames_left(0) {}
+  };
+
+  /* Fixed-capacity ring of instance indices, taken from both ends. */
+  struct alignas(64) Worker {
+    std::mutex                lock;
+    std::unique_ptr<size_t[]> tasks; // Ring of _instances.size() slots
+    size_t                    head; // Index of the front task
+    size_t                    count; // Tasks queued
+    WorkerStats               stats;
+    std::thread               thread;
+  };
+
+  std::vector<std::unique_ptr<Instance>> _instances;
+  std::unique_ptr<Worker[]>              _workers;
+  size_t                                 _worker_count;
+  std::shared_ptr<const Reader>          _rom;
+
+  std::mutex                             _job_lock;
+  std::condition_variable                _job_ready; // Signalled when _generation moves
+  std::condition_variable                _job_done; // Signalled when _pending reaches 0
+  Job                                    _job;
+  uint64_t                               _generation; // Bumped per dispatched job
+  size_t                                 _pending; // Workers yet to finish the job
+  std::exception_ptr                     _error; // First exception a worker hit
+  std::atomic<uint64_t>                  _remaining; // Quanta left in the current run
+  std::atomic<bool>                      _aborted; // A quantum threw: stop the current run
+
+  void dispatch(Job job);
+  void worker_main(size_t self);
+  void build(size_t self);
+  void run(size_t self);
+  bool pop(size_t self, size_t &instance);
+  bool steal(size_t self, size_t &instance);
+  void push(size_t self, size_t instance);
+
+public:
+  /* Build and reset `instances` machines, with `rom` inserted in each if
+   * given, on `workers` threads (one per hardware thread by default).
+   * Throws std::runtime_error if the ROM's mapper is unsupported.
+   */
+  InstancePool(size_t instances, std::shared_ptr<const Reader> rom = nullptr,
+               size_t workers = std::thread::hardware_concurrency());
+  ~InstancePool();
+  InstancePool(const InstancePool &) = delete;
+  InstancePool &operator=(const InstancePool &) = delete;
+
+  size_t             size() const;
+  size_t             worker_count() const;
+
+  /* Only safe while run_frames() is not running. */
+  Machine           &get_machine(size_t index);
+
+  /* Reset the CPU of every machine. */
+  void               reset();
+
+  /* Run every machine for `frames` frames, one frame per quantum, and
+   * return once they all have. If a frame throws, the workers stop after
+   * the quanta they are running and the first exception is rethrown here;
+   * machines are then left part way through the run.
+   */
+  void               run_frames(uint64_t frames);
+
+  /* Counters accumulated over every run_frames() call so far. */
+  const WorkerStats &get_worker_stats(size_t worker) const;
+};
@@ -0,0 +1,104 @@
+#include "./rewind.hpp"
+#include "../io/savestate.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+RewindBuffer::RewindBuffer(NES6502 &cpu, size_t capacity,
+                           size_t keyframe_interval)
+    : _cpu(cpu), _capacity(capacity), _keyframe_interval(keyframe_interval) {
+  if (capacity == 0 || keyframe_interval == 0) {
+    throw std::runtime_error("Rewind buffer needs at least one slot");
+  }
+  /// Every slot can hold a keyframe or a worst-case delta, whichever is
+  /// larger, so a capture can never run out of room.
+  size_t largest = std::max(state_size(cpu), max_delta_size(cpu));
+  _slot_size = (largest + 63) & ~size_t(63);
+  _arena = std::make_unique<uint8_t[]>(_capacity * _slot_size);
+  _slots = std::make_unique<Slot[]>(_capacity);
+  _newest = _capacity - 1;
+  _count = 0;
+  _captures = 0;
+  _keyframes = 0;
+  _capture_ns = 0;
+}
+
+uint8_t *RewindBuffer::slot_data(size_t slot) const {
+  return _arena.get() + slot * _slot_size;
+}
+
+void RewindBuffer::capture() {
+  auto   start = std::chrono::steady_clock::now();
+  size_t slot = (_newest + 1) % _capacity;
+  bool   full = _count == _capacity;
+  size_t oldest = (_newest + _capacity + 1 - _count) % _capacity;
+
+  /// A delta needs its keyframe to stay in the ring; start a new one when
+  /// the interval is up or this capture would overwrite the current one.
+  const Slot *prev = _count > 0 ? &_slots[_newest] : nullptr;
+  bool        keyframe = prev == nullptr ||
+                  prev->since_key >= _keyframe_interval ||
+                  (full && prev->base == slot);
+
+  Slot &out = _slots[slot];
+  if (keyframe) {
+    out.size = save_state(_cpu, slot_data(slot), _slot_size);
+    out.base = slot;
+    out.since_key = 1;
+    _keyframes++;
+  } else {
+    out.size = save_delta(_cpu, slot_data(slot), _slot_size);
+    out.base = prev->base;
+    out.since_key = prev->since_key + 1;
+  }
+  _newest = slot;
+
+  if (full) {
+    /// The oldest capture was just overwritten. Deltas that followed it
+    /// lost their keyframe, so they go too.
+    _count--;
+    oldest = (oldest + 1) % _capacity;
+    while (_count > 0 && _slots[oldest].base != oldest) {
+      _count--;
+      oldest = (oldest + 1) % _capacity;
+    }
+  }
+  _count++;
+  _captures++;
+  _capture_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+}
+
+void RewindBuffer::rewind(size_t frames) {
+  if (frames >= _count) {
+    throw std::runtime_error("Cannot rewind past the oldest capture");
+  }
+  size_t      slot = (_newest + _capacity - frames) % _capacity;
+  const Slot &target = _slots[slot];
+  if (target.base == slot) {
+    load_state(_cpu, slot_data(slot), target.size);
+  } else {
+    load_delta(_cpu, slot_data(target.base), _slots[target.base].size,
+               slot_data(slot), target.size);
+  }
+  _newest = slot;
+  _count -= frames;
+}
+
+size_t RewindBuffer::get_depth() const { return _count; }
+
+RewindStats RewindBuffer::get_stats() const {
+  RewindStats stats;
+  stats.captures = _captures;
+  stats.keyframes = _keyframes;
+  stats.footprint = _capacity * (_slot_size + sizeof(Slot));
+  stats.held_bytes = 0;
+  for (size_t i = 0; i < _count; i++) {
+    stats.held_bytes += _slots[(_newest + _capacity - i) % _capacity].size;
+  }
+  stats.depth = _count;
+  stats.capture_ns = _captures > 0 ? double(_capture_ns) / _captures : 0.0;
+  return stats;
+}
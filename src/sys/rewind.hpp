@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "../dev/nes6502.hpp"
+
+/* Frames between full snapshots. Every other frame is a delta against the
+ * last one, so a rewind costs one full load plus one delta.
+ */
+constexpr size_t REWIND_KEYFRAME_INTERVAL = 30;
+
+struct RewindStats {
+  uint64_t captures; // capture() calls since construction
+  uint64_t keyframes; // Of which were full snapshots
+  size_t   footprint; // Bytes allocated at construction, arena and slot table
+  size_t   held_bytes; // Snapshot bytes currently in the ring
+  size_t   depth; // Captures that can currently be restored
+  double   capture_ns; // Mean wall time per capture()
+};
+
+/*
+ * Fixed-capacity ring of per-frame machine snapshots for rewind and
+ * rollback.
+ *
+ * All memory is allocated by the constructor: one arena of equal slots,
+ * each large enough for the biggest possible state, and a slot table.
+ * capture() writes a full snapshot every `keyframe_interval` frames and
+ * otherwise a delta holding only the RAM pages dirtied since that
+ * keyframe, so it never allocates and copies little. When the ring wraps,
+ * deltas whose keyframe was overwritten are dropped with it.
+ *
+ * The buffer owns the CPU's delta base: calling save_state()/load_state()
+ * on the same CPU behind its back invalidates the deltas it holds.
+ */
+class RewindBuffer {
+private:
+  struct Slot {
+    size_t   size; // Bytes used in the slot
+    size_t   base; // Slot of the keyframe a delta applies to (itself for keyframes)
+    uint32_t since_key; // Captures since that keyframe, counting this one
+  };
+
+  NES6502                   &_cpu;
+  size_t                     _capacity; // Slots in the ring
+  size_t                     _keyframe_interval;
+  size_t                     _slot_size; // Bytes per slot
+  std::unique_ptr<uint8_t[]> _arena; // _capacity slots of _slot_size bytes
+  std::unique_ptr<Slot[]>    _slots;
+  size_t                     _newest; // Slot of the most recent capture
+  size_t                     _count; // Restorable captures, newest backwards
+  uint64_t                   _captures;
+  uint64_t                   _keyframes;
+  uint64_t                   _capture_ns; // Total wall time spent in capture()
+
+  uint8_t                   *slot_data(size_t slot) const;
+
+public:
+  RewindBuffer(NES6502 &cpu, size_t capacity,
+               size_t keyframe_interval = REWIND_KEYFRAME_INTERVAL);
+  RewindBuffer(const RewindBuffer &) = delete;
+  RewindBuffer &operator=(const RewindBuffer &) = delete;
+
+  /* Snapshot the machine. Call once per frame. */
+  void        capture();
+
+  /* Restore the capture `frames` before the most recent one and discard
+   * everything newer; rewind(0) restores the most recent capture.
+   * Throws std::runtime_error if `frames` is not less than get_depth().
+   */
+  void        rewind(size_t frames);
+
+  /* Captures that can currently be restored. */
+  size_t      get_depth() const;
+
+  RewindStats get_stats() const;
+};
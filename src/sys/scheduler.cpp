@@ -0,0 +1,58 @@
+#include "./scheduler.hpp"
+
+#include <algorithm>
+
+Scheduler::Scheduler(NES6502 &cpu, SyncMode mode)
+    : _cpu(cpu), _bus(cpu.get_bus()), _frames(0) {
+  _bus.set_sync_mode(mode);
+}
+
+void     Scheduler::set_mode(SyncMode mode) { _bus.set_sync_mode(mode); }
+SyncMode Scheduler::get_mode() const { return _bus.get_sync_mode(); }
+uint64_t Scheduler::get_frames() const { return _frames; }
+
+void     Scheduler::service_interrupts() {
+  if (_bus.take_nmi()) {
+    _cpu.nmi();
+  }
+  if (_bus.irq()) {
+    _cpu.irq();
+  }
+}
+
+void Scheduler::run_until(uint64_t target) {
+  while (_bus.get_cycles() < target) {
+    uint64_t now = _bus.get_cycles();
+    if (_bus.get_sync_mode() == SyncMode::Lockstep) {
+      _cpu.step();
+      _bus.catch_up();
+      service_interrupts();
+      continue;
+    }
+
+    /// A held but masked IRQ needs no special casing: CLI, PLP and RTI end
+    /// the batch early when they clear I.
+    uint64_t deadline = std::min(target, _bus.next_event());
+    if (deadline > now) {
+      _cpu.run(deadline - now);
+    }
+    _bus.catch_up();
+    service_interrupts();
+  }
+}
+
+void Scheduler::run_cycles(uint64_t cycles) {
+  run_until(_bus.get_cycles() + cycles);
+}
+
+void Scheduler::run_frame() {
+  /// Frame k ends at cycle k * 29780.5 (rounded down), so frames alternate
+  /// between 29780 and 29781 cycles.
+  uint64_t now = _bus.get_cycles();
+  uint64_t frame = now * 2 / CPU_CYCLES_PER_TWO_FRAMES + 1;
+  while (frame * CPU_CYCLES_PER_TWO_FRAMES / 2 <= now) {
+    frame++;
+  }
+  run_until(frame * CPU_CYCLES_PER_TWO_FRAMES / 2);
+  _frames++;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+
+#include "../dev/nes6502.hpp"
+
+/*
+ * Master scheduler.
+ *
+ * Drives one NES6502 and the devices on its Bus from the Bus master clock.
+ * In Batched mode the CPU runs until the earliest timestamp any device has
+ * an event scheduled for (Bus::next_event()), and the devices are caught
+ * up at the end of each batch, or earlier by the Bus if the CPU touches
+ * one of their registers. In Lockstep mode the devices are also caught up
+ * and interrupts polled after every instruction. The mode is stored on the
+ * Bus.
+ */
+class Scheduler {
+private:
+  NES6502 &_cpu;
+  Bus     &_bus;
+  uint64_t _frames; // Frames run by run_frame()
+
+  /* Take a pending interrupt after the devices have been caught up. */
+  void     service_interrupts();
+
+public:
+  explicit Scheduler(NES6502 &cpu, SyncMode mode = SyncMode::Batched);
+
+  void     set_mode(SyncMode mode);
+  SyncMode get_mode() const;
+
+  /* Run until the master clock reaches at least `target`. */
+  void     run_until(uint64_t target);
+
+  /* Run for at least `cycles` CPU cycles. */
+  void     run_cycles(uint64_t cycles);
+
+  /* Run to the end of the next NTSC frame (29780.5 CPU cycles on average). */
+  void     run_frame();
+
+  uint64_t get_frames() const;
+};